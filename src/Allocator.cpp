@@ -0,0 +1,95 @@
+//
+//  Allocator.cpp
+//  BSpline
+//
+
+#include "Allocator.hpp"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+class HeapAllocator: public Allocator
+{
+    public:
+        // the malloc'ed pointer is stored just below the aligned block
+        virtual void *allocate(size_t iSize, size_t iAlign)
+        {
+            if(iAlign < sizeof(void *)) iAlign = sizeof(void *);
+            void *raw = malloc(iSize + iAlign + sizeof(void *));
+            if(!raw) return 0;
+            uintptr_t aligned = (uintptr_t(raw) + sizeof(void *) + iAlign - 1) & ~uintptr_t(iAlign - 1);
+            ((void **)aligned)[-1] = raw;
+            return (void *)aligned;
+        }
+
+        virtual void deallocate(void *iBlock, size_t)
+        {
+            if(iBlock) free(((void **)iBlock)[-1]);
+        }
+};
+
+Allocator &heapAllocator()
+{
+    static HeapAllocator heap;
+    return heap;
+}
+
+Arena::Arena(size_t iChunkSize, Allocator *iUpstream)
+: upstream(iUpstream ? iUpstream : &heapAllocator()), chunkSize(iChunkSize), head(0), current(0), offset(0)
+{ }
+
+Arena::~Arena()
+{
+    while(head) {
+        Chunk *next = head->next;
+        upstream->deallocate(head, head->size + 64);
+        head = next;
+    }
+}
+
+// offset of the first iAlign-aligned address at or after iOffset in a chunk
+static inline size_t alignedOffset(char *iData, size_t iOffset, size_t iAlign)
+{
+    uintptr_t base = uintptr_t(iData);
+    return ((base + iOffset + iAlign - 1) & ~uintptr_t(iAlign - 1)) - base;
+}
+
+void *Arena::allocate(size_t iSize, size_t iAlign)
+{
+    while(current) {
+        size_t start = alignedOffset(chunkData(current), offset, iAlign);
+        if(start + iSize <= current->size) {
+            offset = start + iSize;
+            return chunkData(current) + start;
+        }
+        if(!current->next) break;
+        current = current->next;
+        offset = 0;
+    }
+
+    // splice a new chunk in after the current one
+    size_t size = (iSize + iAlign > chunkSize) ? iSize + iAlign : chunkSize;
+    Chunk *chunk = (Chunk *)upstream->allocate(size + 64, 64);
+    if(!chunk) return 0;
+    chunk->size = size;
+    if(current) {
+        chunk->next = current->next;
+        current->next = chunk;
+    } else {
+        chunk->next = head;
+        head = chunk;
+    }
+    current = chunk;
+
+    size_t start = alignedOffset(chunkData(chunk), 0, iAlign);
+    offset = start + iSize;
+    return chunkData(chunk) + start;
+}
+
+size_t Arena::capacity() const
+{
+    size_t total = 0;
+    for(Chunk *chunk = head; chunk; chunk = chunk->next)
+        total += chunk->size;
+    return total;
+}
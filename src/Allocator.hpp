@@ -0,0 +1,105 @@
+//
+//  Allocator.hpp
+//  BSpline
+//
+
+#ifndef Allocator_hpp
+#define Allocator_hpp
+
+#include <stdio.h>
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+
+// Memory hook for owning spline storage. iAlign is a power of two.
+class Allocator
+{
+    public:
+        virtual ~Allocator() { }
+
+        virtual void *allocate(size_t iSize, size_t iAlign) = 0;
+        virtual void deallocate(void *iBlock, size_t iSize) = 0;
+};
+
+// Aligned malloc/free, used when no allocator is given.
+Allocator &heapAllocator();
+
+// Monotonic arena. allocate bumps a pointer through a list of chunks drawn
+// from iUpstream; deallocate does nothing. reset rewinds to the first chunk
+// in O(1) and later allocations reuse the chunks, so a steady planning cycle
+// stops calling the upstream allocator after the first pass.
+class Arena: public Allocator
+{
+    public:
+        Arena(size_t iChunkSize = 65536, Allocator *iUpstream = 0);
+        ~Arena();
+
+        virtual void *allocate(size_t iSize, size_t iAlign);
+        virtual void deallocate(void *, size_t) { }
+
+        void reset() { current = head; offset = 0; }
+
+        // bytes held from the upstream allocator
+        size_t capacity() const;
+
+    protected:
+        struct Chunk
+        {
+            Chunk *next;
+            size_t size;
+        };
+
+        static char *chunkData(Chunk *iChunk) { return (char *)iChunk + 64; }
+
+    protected:
+        Allocator *upstream;
+        size_t chunkSize;
+        Chunk *head;
+        Chunk *current;
+        size_t offset;
+
+    private:
+        Arena(const Arena &);
+        Arena &operator=(const Arena &);
+};
+
+// Standard library adapter so containers can draw from an Allocator.
+// A null allocator means the aligned heap.
+template<typename T>
+class StdAllocator
+{
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+    public:
+        StdAllocator(Allocator *iAllocator = 0)
+        : allocator(iAllocator ? iAllocator : &heapAllocator())
+        { }
+
+        template<typename U>
+        StdAllocator(const StdAllocator<U> &iOther)
+        : allocator(iOther.allocator)
+        { }
+
+        T *allocate(size_t n)
+        {
+            void *block = allocator->allocate(n * sizeof(T), (alignof(T) > 64) ? alignof(T) : 64);
+            if(!block) throw std::bad_alloc();
+            return (T *)block;
+        }
+
+        void deallocate(T *p, size_t n) { allocator->deallocate(p, n * sizeof(T)); }
+
+    public:
+        Allocator *allocator;
+};
+
+template<typename T, typename U>
+inline bool operator==(const StdAllocator<T> &a, const StdAllocator<U> &b) { return a.allocator == b.allocator; }
+
+template<typename T, typename U>
+inline bool operator!=(const StdAllocator<T> &a, const StdAllocator<U> &b) { return a.allocator != b.allocator; }
+
+#endif /* Allocator_hpp */
@@ -6,9 +6,44 @@
 //
 
 #include "BSpline.hpp"
+#include "Simd.hpp"
+#include "KnotSpan.hpp"
 
-BSpline::BSpline(float *iCPBuffer, float *iKnotBuffer, int iMaxCount, int iOrder)
-: cpBuffer(iCPBuffer), knots(iKnotBuffer), stride(0), maxCPCount(iMaxCount), order(iOrder), cpCount(0)
+#include <math.h>
+
+// Uniform cubic basis matrices, in twelfths. Row j holds the power basis
+// coefficients of N(span - 3 + j) in the span-local x. The clamped end
+// spans use the start matrices mirrored.
+static const float cubicInterior[16] = {
+    2.0, -6.0,   6.0, -2.0,
+    8.0,  0.0, -12.0,  6.0,
+    2.0,  6.0,   6.0, -6.0,
+    0.0,  0.0,   0.0,  2.0
+};
+
+// first span of a clamped uniform knot vector
+static const float cubicFirst[16] = {
+    12.0, -36.0,  36.0, -12.0,
+     0.0,  36.0, -54.0,  21.0,
+     0.0,   0.0,  18.0, -11.0,
+     0.0,   0.0,   0.0,   2.0
+};
+
+// second span of a clamped uniform knot vector
+static const float cubicSecond[16] = {
+    3.0, -9.0,   9.0, -3.0,
+    7.0,  3.0, -15.0,  7.0,
+    2.0,  6.0,   6.0, -6.0,
+    0.0,  0.0,   0.0,  2.0
+};
+
+static const float twelfth = 1.0 / 12.0;
+
+BSpline::BSpline(float *iCPBuffer, float *iKnotBuffer, int iMaxCount, int iOrder, Allocator *iAllocator)
+: cpBuffer(iCPBuffer), knots(iKnotBuffer), planes(0), planePitch(0), stride(0), maxCPCount(iMaxCount), order(iOrder), cpCount(0), knotClass(GeneralKnots), knotSpacing(0.0), cubicKernel(false),
+  allocator(iAllocator ? iAllocator : &heapAllocator()), revision(0),
+  knotBuffer(iKnotBuffer), tableStride(0), invKnotDiffs(StdAllocator<float>(allocator)), invKnotSpacing(0.0), uniformFirst(0), uniformLast(-1),
+  uniformBasis(StdAllocator<float>(allocator))
 { }
 
 void BSpline::init(int iStride, int iCPCount)
@@ -19,68 +54,842 @@ void BSpline::init(int iStride, int iCPCount)
 
     float k = 1.0;
     int i = order;
-    while(i--) knots[i] = 0.0;
+    while(i--) knotBuffer[i] = 0.0;
     for(i = order; i < cpCount; i++, k++)
-        knots[i] = k;
+        knotBuffer[i] = k;
     for(i = cpCount; i < knotCount; i++)
-        knots[i] = k;
+        knotBuffer[i] = k;
+
+    updateKnots();
+}
+
+// Copies a caller-supplied knot vector of iCPCount + order values. Returns
+// false, leaving the spline unchanged, if the knots decrease, a knot repeats
+// more than order times, or the domain is empty.
+bool BSpline::init(int iStride, int iCPCount, const float *iKnots)
+{
+    if((iCPCount > maxCPCount) || !validKnots(iCPCount, iKnots)) return false;
+
+    int knotCount = iCPCount + order;
+    stride = iStride;
+    cpCount = iCPCount;
+    for(int i = 0; i < knotCount; i++)
+        knotBuffer[i] = iKnots[i];
+
+    updateKnots();
+    return true;
+}
+
+// The checks init applies to a caller-supplied knot vector, capacity aside.
+bool BSpline::validKnots(int iCPCount, const float *iKnots) const
+{
+    if(iCPCount < order) return false;
+
+    int knotCount = iCPCount + order;
+    int run = 1;
+    for(int i = 1; i < knotCount; i++) {
+        if(iKnots[i] < iKnots[i - 1]) return false;
+        run = (iKnots[i] == iKnots[i - 1]) ? run + 1 : 1;
+        if(run > order) return false;
+    }
+    return iKnots[iCPCount] > iKnots[order - 1];
+}
+
+// Rebuilds the reciprocal knot difference tables and the knot class after
+// anything that writes knotBuffer.
+void BSpline::updateKnots()
+{
+    int knotCount = cpCount + order;
+    tableStride = knotCount;
+    invKnotDiffs.assign((order - 1) * knotCount, 0.0);
+    for(int k = 1; k < order; k++) {
+        float *row = &invKnotDiffs[(k - 1) * knotCount];
+        for(int i = 0; i + k < knotCount; i++) {
+            float d = knots[i + k] - knots[i];
+            row[i] = (d != 0.0) ? 1.0 / d : 0.0;
+        }
+    }
+
+    classifyKnots();
+    revision++;
+}
+
+// Uniform knots lie on one lattice throughout; clamped uniform knots lie on
+// it over the domain and repeat order times at each end. Spans whose 2 * (order - 1)
+// supporting knots are all on the lattice share one basis, kept in uniformBasis.
+void BSpline::classifyKnots()
+{
+    int p = order - 1;
+    int lo = p;
+    int hi = cpCount;
+    int knotCount = cpCount + order;
+    float u0 = knots[lo];
+    float h = (knots[hi] - u0) / float(hi - lo);
+    float tol = 1.0e-5 * h;
+
+    knotClass = GeneralKnots;
+    knotSpacing = 0.0;
+    invKnotSpacing = 0.0;
+    uniformFirst = 0;
+    uniformLast = -1;
+    int first = 0;
+    int last = -1;
+
+    bool lattice = true;
+    for(int i = lo; lattice && (i <= hi); i++)
+        lattice = fabs(knots[i] - u0 - float(i - lo) * h) <= tol;
+
+    if(lattice) {
+        bool uniform = true;
+        for(int i = 0; uniform && (i < knotCount); i++)
+            uniform = fabs(knots[i] - u0 - float(i - lo) * h) <= tol;
+
+        bool clamped = true;
+        for(int i = 0; clamped && (i < p); i++)
+            clamped = (knots[i] == u0) && (knots[hi + 1 + i] == knots[hi]);
+
+        if(uniform) {
+            knotClass = UniformKnots;
+            first = lo;
+            last = hi - 1;
+        } else if(clamped) {
+            knotClass = ClampedUniformKnots;
+            first = 2 * p - 1;
+            last = cpCount - p;
+        }
+    }
+
+    if(knotClass != GeneralKnots) {
+        knotSpacing = h;
+        invKnotSpacing = 1.0 / h;
+    }
+
+    // no span is marked uniform yet, so spanBasis runs the general recursion
+    if(first <= last) {
+        uniformBasis.resize(order * order);
+        spanBasis(first, &uniformBasis[0]);
+    }
+    uniformFirst = first;
+    uniformLast = last;
+
+    // the closed clamped matrices need the two special spans at each end to be distinct
+    cubicKernel = (order == 4) && ((knotClass == UniformKnots) || ((knotClass == ClampedUniformKnots) && (cpCount >= 7)));
+}
+
+const float *BSpline::cubicMatrix(int iSpan, bool &oMirror) const
+{
+    oMirror = false;
+    if(knotClass == ClampedUniformKnots) {
+        if(iSpan == 3) return cubicFirst;
+        if(iSpan == 4) return cubicSecond;
+        oMirror = true;
+        if(iSpan == cpCount - 1) return cubicFirst;
+        if(iSpan == cpCount - 2) return cubicSecond;
+        oMirror = false;
+    }
+    return cubicInterior;
+}
+
+void BSpline::cubicWeights(int iSpan, float t, float *oW) const
+{
+    bool mirror;
+    const float *m = cubicMatrix(iSpan, mirror);
+    float x = (t - knots[iSpan]) * invKnotSpacing;
+    if(mirror) x = 1.0 - x;
+
+    for(int j = 0; j < 4; j++, m += 4) {
+        float v = ((m[3] * x + m[2]) * x + m[1]) * x + m[0];
+        oW[mirror ? 3 - j : j] = v * twelfth;
+    }
+}
+
+void BSpline::cubicDerivWeights(int iSpan, float t, float *oW) const
+{
+    bool mirror;
+    const float *m = cubicMatrix(iSpan, mirror);
+    float x = (t - knots[iSpan]) * invKnotSpacing;
+    float f = twelfth * invKnotSpacing;
+    if(mirror) {
+        x = 1.0 - x;
+        f = -f;
+    }
+
+    for(int j = 0; j < 4; j++, m += 4) {
+        float v = (3.0f * m[3] * x + 2.0f * m[2]) * x + m[1];
+        oW[mirror ? 3 - j : j] = v * f;
+    }
+}
+
+// Reads control points from dimension planes at iPlanes + i * iPitch (see
+// Planar.hpp) instead of cpBuffer. Pass 0 to return to cpBuffer. Either
+// switch can change the curve, so derived caches are invalidated.
+void BSpline::usePlanar(float *iPlanes, int iPitch)
+{
+    planes = iPlanes;
+    planePitch = iPitch;
+    touch();
+}
+
+// The order control points from iSpan - order + 1, interleaved. Points into
+// cpBuffer directly, or gathers from the planes into iScratch (order * stride).
+// Only for callers that need a working copy anyway (de Boor, Bezier
+// extraction); evaluation reads the planes in place through spanSum.
+const float *BSpline::spanPoints(int iSpan, float *iScratch) const
+{
+    int first = iSpan - order + 1;
+    if(!planes) return cpBuffer + first * stride;
+
+    for(int i = 0; i < stride; i++) {
+        const float *plane = planes + i * planePitch + first;
+        for(int j = 0; j < order; j++)
+            iScratch[j * stride + i] = plane[j];
+    }
+    return iScratch;
+}
+
+float BSpline::clamp(float t) const
+{
+    if(t < knots[order - 1]) return knots[order - 1];
+    if(t > knots[cpCount]) return knots[cpCount];
+    return t;
 }
 
-float BSpline::basis(int i, int k, float t)
+float BSpline::basis(int i, int k, float t) const
 {
     if(!k) return ((knots[i] <= t) && (t <= knots[i+1])) ? 1.0 : 0.0;
 
     float n0 = t - knots[i];
-    float d0 = knots[i + k] - knots[i];
     float b0 = basis(i, k - 1, t);
 
     float n1 = knots[i + k + 1] - t;
-    float d1 = knots[i + k + 1] - knots[i + 1];
     float b1 = basis(i + 1, k - 1, t);
 
-    float left = ((b0 != 0.0) && (d0 != 0.0)) ? n0 * b0 / d0 : 0.0;
-    float right = ((b1 != 0.0) && (d1 != 0.0)) ? n1 * b1 / d1 : 0.0;
-    return left + right;
+    // empty spans have a zero reciprocal, which zeroes their term
+    return n0 * b0 * invKnotDiff(k, i) + n1 * b1 * invKnotDiff(k, i + 1);
 }
 
-void BSpline::eval(float t, float *oPoint)
+int BSpline::findSpan(float t, int iHint) const
 {
-    int knotCount = cpCount + order;
-    if(t < 0.0) t = 0.0;
-
-    if(t > knots[knotCount - 1])
-        t = knots[knotCount - 1];
+    float invSpacing = (knotClass != GeneralKnots) ? invKnotSpacing : 0.0f;
+    return findKnotSpan(knots, 1, order - 1, cpCount - 1, t, invSpacing, iHint);
+}
 
-    for(int i = 0; i < stride; i++)
-        oPoint[i] = 0.0;
+// The iDegree + 1 basis functions of degree iDegree that are non-zero over
+// iSpan, N(iSpan - iDegree) .. N(iSpan), evaluated at t.
+void BSpline::basisFuns(int iSpan, float t, int iDegree, float *oN) const
+{
+    float left[iDegree + 1];
+    float right[iDegree + 1];
 
-    for(int j = 0; j < cpCount; j++) {
-        float b = basis(j, order - 1, t);
-        int offset = j * stride;
-        for(int i = 0; i < stride; i++)
-            oPoint[i] += cpBuffer[offset + i] * b;
+    oN[0] = 1.0;
+    for(int j = 1; j <= iDegree; j++) {
+        left[j] = t - knots[iSpan + 1 - j];
+        right[j] = knots[iSpan + j] - t;
+        float saved = 0.0;
+        for(int r = 0; r < j; r++) {
+            float temp = oN[r] * invKnotDiff(j, iSpan + 1 - j + r);
+            oN[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        oN[j] = saved;
     }
 }
 
-void BSpline::deriv(float t, float *oPoint)
+// Weights of the order control points from iSpan - order + 1 for the point
+// at t: the uniform span basis when it applies, A2.2 otherwise.
+void BSpline::evalWeights(int iSpan, float t, float *oW) const
 {
-    int knotCount = cpCount + order;
-    if(t < 0.0) t = 0.0;
+    if(cubicKernel) {
+        cubicWeights(iSpan, t, oW);
+        return;
+    }
+
+    if(!isUniformSpan(iSpan)) {
+        basisFuns(iSpan, t, order - 1, oW);
+        return;
+    }
 
-    if(t > knots[knotCount - 1])
-        t = knots[knotCount - 1];
+    float x = (t - knots[iSpan]) * invKnotSpacing;
+    for(int j = 0; j < order; j++) {
+        const float *b = &uniformBasis[j * order];
+        float v = b[order - 1];
+        for(int k = order - 2; k >= 0; k--)
+            v = v * x + b[k];
+        oW[j] = v;
+    }
+}
 
+// Same as evalWeights for the first derivative.
+void BSpline::derivWeights(int iSpan, float t, float *oW) const
+{
     int n = order - 1;
 
+    if(cubicKernel) {
+        cubicDerivWeights(iSpan, t, oW);
+        return;
+    }
+
+    if(isUniformSpan(iSpan)) {
+        float x = (t - knots[iSpan]) * invKnotSpacing;
+        for(int j = 0; j < order; j++) {
+            const float *b = &uniformBasis[j * order];
+            float v = float(n) * b[n];
+            for(int k = n - 1; k >= 1; k--)
+                v = v * x + float(k) * b[k];
+            oW[j] = v * invKnotSpacing;
+        }
+        return;
+    }
+
+    // Q[j] = n * (P[j+1] - P[j]) / (knots[j+n+1] - knots[j+1]) weighted by
+    // the degree n - 1 basis, folded into one weight per control point
+    int first = iSpan - n;
+    float nd[order];
+    basisFuns(iSpan, t, n - 1, nd);
+
+    for(int j = 0; j <= n; j++)
+        oW[j] = 0.0;
+    for(int j = 0; j < n; j++) {
+        float fn = float(n) * invKnotDiff(n, first + j + 1) * nd[j];
+        oW[j] -= fn;
+        oW[j + 1] += fn;
+    }
+}
+
+// Basis functions non-zero over iSpan and their derivatives up to order n
+// (NURBS Book A2.3). oDers[k * order + j] is the k-th derivative of
+// N(iSpan - order + 1 + j); n must not exceed order - 1.
+void BSpline::dersBasisFuns(int iSpan, float t, int n, float *oDers) const
+{
+    int p = order - 1;
+    float ndu[order * order];
+    float left[order];
+    float right[order];
+    float a[2 * order];
+
+    ndu[0] = 1.0;
+    for(int j = 1; j <= p; j++) {
+        left[j] = t - knots[iSpan + 1 - j];
+        right[j] = knots[iSpan + j] - t;
+        float saved = 0.0;
+        for(int r = 0; r < j; r++) {
+            // lower triangle holds reciprocal knot differences, upper the basis values
+            ndu[j * order + r] = invKnotDiff(j, iSpan + 1 - j + r);
+            float temp = ndu[r * order + j - 1] * ndu[j * order + r];
+            ndu[r * order + j] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        ndu[j * order + j] = saved;
+    }
+
+    for(int j = 0; j <= p; j++)
+        oDers[j] = ndu[j * order + p];
+
+    for(int r = 0; r <= p; r++) {
+        float *a0 = a;
+        float *a1 = a + order;
+        a0[0] = 1.0;
+        for(int k = 1; k <= n; k++) {
+            float d = 0.0;
+            int rk = r - k;
+            int pk = p - k;
+            if(r >= k) {
+                a1[0] = a0[0] * ndu[(pk + 1) * order + rk];
+                d = a1[0] * ndu[rk * order + pk];
+            }
+            int j1 = (rk >= -1) ? 1 : -rk;
+            int j2 = (r - 1 <= pk) ? k - 1 : p - r;
+            for(int j = j1; j <= j2; j++) {
+                a1[j] = (a0[j] - a0[j - 1]) * ndu[(pk + 1) * order + rk + j];
+                d += a1[j] * ndu[(rk + j) * order + pk];
+            }
+            if(r <= pk) {
+                a1[k] = -a0[k - 1] * ndu[(pk + 1) * order + r];
+                d += a1[k] * ndu[r * order + pk];
+            }
+            oDers[k * order + r] = d;
+            float *swap = a0;
+            a0 = a1;
+            a1 = swap;
+        }
+    }
+
+    float f = float(p);
+    for(int k = 1; k <= n; k++) {
+        for(int j = 0; j <= p; j++)
+            oDers[k * order + j] *= f;
+        f *= float(p - k);
+    }
+}
+
+void BSpline::deBoor(int iSpan, float t, float *oPoint) const
+{
+    int p = order - 1;
+    float d[order * stride];
+
+    const float *cp = spanPoints(iSpan, d);
+    if(cp != d)
+        for(int i = 0; i < order * stride; i++)
+            d[i] = cp[i];
+
+    for(int r = 1; r <= p; r++) {
+        for(int j = p; j >= r; j--) {
+            int k = iSpan - p + j;
+            float a = (t - knots[k]) * invKnotDiff(order - r, k);
+            float *dj = d + j * stride;
+            float *dl = dj - stride;
+            for(int i = 0; i < stride; i++)
+                dj[i] = dl[i] + a * (dj[i] - dl[i]);
+        }
+    }
+
+    int offset = p * stride;
     for(int i = 0; i < stride; i++)
-        oPoint[i] = 0.0;
+        oPoint[i] = d[offset + i];
+}
+
+// Power basis coefficients of the order basis functions that are non-zero
+// over iSpan, in x = (t - knots[iSpan]) / (knots[iSpan + 1] - knots[iSpan]).
+// oBasis[j * order + k] is the x^k coefficient of N(iSpan - order + 1 + j).
+void BSpline::spanBasis(int iSpan, float *oBasis) const
+{
+    if(cubicKernel) {
+        bool mirror;
+        const float *m = cubicMatrix(iSpan, mirror);
+        for(int j = 0; j < 4; j++, m += 4) {
+            float *b = oBasis + (mirror ? 3 - j : j) * 4;
+            if(mirror) {
+                // expand m(1 - x)
+                b[0] = (m[0] + m[1] + m[2] + m[3]) * twelfth;
+                b[1] = -(m[1] + 2.0f * m[2] + 3.0f * m[3]) * twelfth;
+                b[2] = (m[2] + 3.0f * m[3]) * twelfth;
+                b[3] = -m[3] * twelfth;
+            } else {
+                for(int k = 0; k < 4; k++)
+                    b[k] = m[k] * twelfth;
+            }
+        }
+        return;
+    }
+
+    if(isUniformSpan(iSpan)) {
+        for(int i = 0; i < order * order; i++)
+            oBasis[i] = uniformBasis[i];
+        return;
+    }
+
+    int p = order - 1;
+    float u0 = knots[iSpan];
+    float h = knots[iSpan + 1] - u0;
+
+    for(int i = 0; i < order * order; i++)
+        oBasis[i] = 0.0;
+    oBasis[0] = 1.0;
+
+    float saved[order];
+    for(int j = 1; j <= p; j++) {
+        for(int k = 0; k <= j; k++)
+            saved[k] = 0.0;
+        for(int r = 0; r < j; r++) {
+            float *n = oBasis + r * order;
+            float ul = knots[iSpan + 1 - j + r];
+            float ur = knots[iSpan + r + 1];
+            float inv = invKnotDiff(j, iSpan + 1 - j + r);
+
+            // right = (ur - u0) - h x, left = (u0 - ul) + h x
+            float r0 = (ur - u0) * inv, r1 = -h * inv;
+            float l0 = (u0 - ul) * inv, l1 = h * inv;
+            float next[order];
+            for(int k = 0; k <= j; k++) {
+                float nk = (k < j) ? n[k] : 0.0;
+                float nk1 = k ? n[k - 1] : 0.0;
+                next[k] = saved[k] + r0 * nk + r1 * nk1;
+                saved[k] = l0 * nk + l1 * nk1;
+            }
+            for(int k = 0; k <= j; k++)
+                n[k] = next[k];
+        }
+        float *n = oBasis + j * order;
+        for(int k = 0; k <= j; k++)
+            n[k] = saved[k];
+    }
+}
+
+// Span polynomial in the same local x as spanBasis.
+// oCoeffs[k * stride + i] is the x^k coefficient of dimension i.
+void BSpline::spanCoefficients(int iSpan, float *oCoeffs) const
+{
+    float b[order * order];
+    spanBasis(iSpan, b);
+
+    if(planes) {
+        // a pass over each plane's order points
+        const float *plane = planes + iSpan - order + 1;
+        for(int i = 0; i < stride; i++, plane += planePitch) {
+            for(int k = 0; k < order; k++) {
+                float acc = 0.0;
+                for(int j = 0; j < order; j++)
+                    acc += plane[j] * b[j * order + k];
+                oCoeffs[k * stride + i] = acc;
+            }
+        }
+        return;
+    }
+
+    for(int i = 0; i < order * stride; i++)
+        oCoeffs[i] = 0.0;
+
+    const float *points = cpBuffer + (iSpan - order + 1) * stride;
+    for(int j = 0; j < order; j++) {
+        const float *cp = points + j * stride;
+        for(int k = 0; k < order; k++) {
+            float w = b[j * order + k];
+            float *c = oCoeffs + k * stride;
+            for(int i = 0; i < stride; i++)
+                c[i] += cp[i] * w;
+        }
+    }
+}
+
+// oOut[i] = sum over j < order of iWeights[j] * P(iSpan - order + 1 + j)[i],
+// read in place from either layout. Interleaved rows are one point each;
+// planar rows are one dimension each, planePitch apart.
+void BSpline::spanSum(WeightedSumFn iSum, int iSpan, const float *iWeights, float *oOut) const
+{
+    int first = iSpan - order + 1;
+    if(!planes) {
+        iSum(cpBuffer + first * stride, stride, iWeights, order, stride, oOut);
+        return;
+    }
+
+    rowDotsKernel()(planes + first, planePitch, iWeights, order, stride, oOut);
+}
+
+void BSpline::eval(float t, float *oPoint) const
+{
+    t = clamp(t);
+    int span = findSpan(t);
+    float w[order];
+    evalWeights(span, t, w);
+    spanSum(weightedSumKernel(), span, w, oPoint);
+}
+
+void BSpline::deriv(float t, float *oPoint) const
+{
+    t = clamp(t);
+    int span = findSpan(t);
+    float w[order];
+    derivWeights(span, t, w);
+    spanSum(weightedSumKernel(), span, w, oPoint);
+}
+
+// Position and derivatives 1 .. nDerivs at t from a single basis table.
+// out[k * stride + i] is dimension i of the k-th derivative.
+void BSpline::evalDerivs(float t, int nDerivs, float *out) const
+{
+    t = clamp(t);
+
+    int p = order - 1;
+    int n = (nDerivs < p) ? nDerivs : p;
+    int span = findSpan(t);
+    float ders[order * order];
+
+    if(cubicKernel || isUniformSpan(span)) {
+        // d^k/dt^k of the closed form span polynomials
+        float basis[order * order];
+        spanBasis(span, basis);
+        float x = (t - knots[span]) * invKnotSpacing;
+        float scale = 1.0;
+        for(int k = 0; k <= n; k++, scale *= invKnotSpacing) {
+            for(int j = 0; j < order; j++) {
+                const float *b = basis + j * order;
+                float v = 0.0;
+                for(int m = p; m >= k; m--) {
+                    float f = 1.0;
+                    for(int q = m - k + 1; q <= m; q++)
+                        f *= float(q);
+                    v = v * x + f * b[m];
+                }
+                ders[k * order + j] = v * scale;
+            }
+        }
+    } else {
+        dersBasisFuns(span, t, n, ders);
+    }
+
+    WeightedSumFn sum = weightedSumKernel();
+    for(int k = 0; k <= n; k++)
+        spanSum(sum, span, ders + k * order, out + k * stride);
+
+    for(int i = (n + 1) * stride; i < (nDerivs + 1) * stride; i++)
+        out[i] = 0.0;
+}
+
+void BSpline::evalBatch(const float *ts, int n, float *out) const
+{
+    batch(ts, n, false, out);
+}
+
+void BSpline::derivBatch(const float *ts, int n, float *out) const
+{
+    batch(ts, n, true, out);
+}
+
+// Samples are taken batchBlock at a time. A first pass clamps them and finds
+// their spans, staying in the previous span while it holds; then each run of samples sharing a span goes to one
+// hornerSum call, which keeps the span polynomial in registers across the run.
+void BSpline::batch(const float *ts, int n, bool iDeriv, float *out) const
+{
+    const int batchBlock = 64;
+    int p = order - 1;
+    int degree = iDeriv ? p - 1 : p;
+    HornerSumFn horner = hornerSumKernel();
+
+    int lo = order - 1;
+    int hi = cpCount - 1;
+    float tMin = knots[lo];
+    float tMax = knots[hi + 1];
+
+    float coeffs[order * stride];
+    float x[batchBlock];
+    int spans[batchBlock];
+    int span = -1;
+    int loaded = -1;
+    float u0 = 0.0, invH = 0.0;
+
+    for(int base = 0; base < n; base += batchBlock) {
+        int count = (n - base < batchBlock) ? n - base : batchBlock;
+        if(knotClass != GeneralKnots) {
+            // findSpan's lattice lookup, inlined
+            for(int m = 0; m < count; m++) {
+                float t = ts[base + m];
+                t = (t < tMin) ? tMin : ((t > tMax) ? tMax : t);
+                x[m] = t;
+                spans[m] = latticeSpan(knots, 1, lo, hi, t, invKnotSpacing);
+            }
+        } else {
+            for(int m = 0; m < count; m++) {
+                float t = ts[base + m];
+                t = (t < tMin) ? tMin : ((t > tMax) ? tMax : t);
+                if((span < 0) || (t < knots[span]) || (t >= knots[span + 1]))
+                    span = findSpan(t, span);
+                x[m] = t;
+                spans[m] = span;
+            }
+        }
+
+        for(int first = 0; first < count; ) {
+            int s = spans[first];
+            int last = first + 1;
+            while((last < count) && (spans[last] == s))
+                last++;
+
+            if(s != loaded) {
+                loaded = s;
+                spanCoefficients(s, coeffs);
+                u0 = knots[s];
+                invH = invKnotDiff(1, s);
+                if(iDeriv) {
+                    // differentiate in place: row k - 1 becomes k * c[k] / h
+                    for(int k = 1; k <= p; k++) {
+                        float f = float(k) * invH;
+                        float *dst = coeffs + (k - 1) * stride;
+                        const float *src = dst + stride;
+                        for(int i = 0; i < stride; i++)
+                            dst[i] = src[i] * f;
+                    }
+                }
+            }
+            for(int m = first; m < last; m++)
+                x[m] = (x[m] - u0) * invH;
+
+            horner(coeffs, stride, degree, x + first, last - first, stride, out + (base + first) * stride, stride);
+            first = last;
+        }
+    }
+}
+
+// Multiplicity of u among the knots, for knots in [knots[order - 1], knots[cpCount]).
+static int knotMultiplicity(const float *iKnots, int iSpan, float u)
+{
+    int s = 0;
+    for(int i = iSpan; (i >= 0) && (iKnots[i] == u); i--)
+        s++;
+    return s;
+}
+
+bool BSpline::insertKnot(float u, int r)
+{
+    int p = order - 1;
+    if(planes || (r < 1) || (u < knots[p]) || (u >= knots[cpCount])) return false;
+
+    int k = findSpan(u);
+    int s = knotMultiplicity(knots, k, u);
+    if(s + r > p) return false;
+    if(!reserveCPs(cpCount + r)) return false;
+
+    // affected points P[k - p] .. P[k - s], the rest only shift by r
+    int nr = p - s + 1;
+    float rw[nr * stride];
+    for(int i = 0; i < nr * stride; i++)
+        rw[i] = cpBuffer[(k - p) * stride + i];
+
+    int n = cpCount - 1;
+    for(int i = n; i >= k - s; i--)
+        for(int d = 0; d < stride; d++)
+            cpBuffer[(i + r) * stride + d] = cpBuffer[i * stride + d];
+
+    int last = k - p;
+    for(int j = 1; j <= r; j++) {
+        last = k - p + j;
+        for(int i = 0; i <= p - j - s; i++) {
+            float a = (u - knots[last + i]) / (knots[i + k + 1] - knots[last + i]);
+            float *r0 = rw + i * stride;
+            const float *r1 = r0 + stride;
+            for(int d = 0; d < stride; d++)
+                r0[d] = r0[d] + a * (r1[d] - r0[d]);
+        }
+        for(int d = 0; d < stride; d++) {
+            cpBuffer[last * stride + d] = rw[d];
+            cpBuffer[(k + r - j - s) * stride + d] = rw[(p - j - s) * stride + d];
+        }
+    }
+    for(int i = last + 1; i < k - s; i++)
+        for(int d = 0; d < stride; d++)
+            cpBuffer[i * stride + d] = rw[(i - last) * stride + d];
+
+    int m = cpCount + p;
+    for(int i = m; i > k; i--)
+        knotBuffer[i + r] = knotBuffer[i];
+    for(int i = 1; i <= r; i++)
+        knotBuffer[k + i] = u;
+
+    cpCount += r;
+    updateKnots();
+    return true;
+}
+
+bool BSpline::refineKnots(const float *iKnots, int iCount)
+{
+    int p = order - 1;
+    if(iCount <= 0) return iCount == 0;
+    if(planes) return false;
+
+    // sorted, inside the domain, and no knot past multiplicity p
+    for(int j = 0; j < iCount; j++) {
+        float x = iKnots[j];
+        if((x < knots[p]) || (x >= knots[cpCount])) return false;
+        if((j > 0) && (x < iKnots[j - 1])) return false;
+        if((j > 0) && (x == iKnots[j - 1])) continue;
+        int run = 1;
+        while((j + run < iCount) && (iKnots[j + run] == x))
+            run++;
+        if(knotMultiplicity(knots, findSpan(x), x) + run > p) return false;
+    }
+    if(!reserveCPs(cpCount + iCount)) return false;
+
+    int n = cpCount - 1;
+    int m = n + p + 1;
+    std::vector<float, StdAllocator<float> > pw(cpBuffer, cpBuffer + cpCount * stride, StdAllocator<float>(allocator));
+    std::vector<float, StdAllocator<float> > u(knots, knots + m + 1, StdAllocator<float>(allocator));
+
+    int r = iCount - 1;
+    int a = findSpan(iKnots[0]);
+    int b = findSpan(iKnots[r]) + 1;
+
+    float *qw = cpBuffer;
+    float *ub = knotBuffer;
+    for(int j = b - 1; j <= n; j++)
+        for(int d = 0; d < stride; d++)
+            qw[(j + r + 1) * stride + d] = pw[j * stride + d];
+    for(int j = b + p; j <= m; j++)
+        ub[j + r + 1] = u[j];
+
+    int i = b + p - 1;
+    int k = b + p + r;
+    for(int j = r; j >= 0; j--) {
+        while((iKnots[j] <= u[i]) && (i > a)) {
+            for(int d = 0; d < stride; d++)
+                qw[(k - p - 1) * stride + d] = pw[(i - p - 1) * stride + d];
+            ub[k] = u[i];
+            k--;
+            i--;
+        }
+        for(int d = 0; d < stride; d++)
+            qw[(k - p - 1) * stride + d] = qw[(k - p) * stride + d];
+        for(int l = 1; l <= p; l++) {
+            int ind = k - p + l;
+            float alpha = ub[k + l] - iKnots[j];
+            float *q0 = qw + (ind - 1) * stride;
+            const float *q1 = q0 + stride;
+            if(alpha == 0.0) {
+                for(int d = 0; d < stride; d++)
+                    q0[d] = q1[d];
+            } else {
+                alpha /= ub[k + l] - u[i - p + l];
+                for(int d = 0; d < stride; d++)
+                    q0[d] = q1[d] + alpha * (q0[d] - q1[d]);
+            }
+        }
+        ub[k] = iKnots[j];
+        k--;
+    }
+
+    cpCount += iCount;
+    updateKnots();
+    return true;
+}
+
+int BSpline::segmentCount() const
+{
+    int count = 0;
+    for(int s = order - 1; s < cpCount; s++)
+        if(knots[s + 1] > knots[s])
+            count++;
+    return count;
+}
+
+// Bezier point i of a span is the blossom of the span polynomial at
+// (knots[span + 1] x i, knots[span] x (p - i)): de Boor's triangle with the
+// first i levels run at the span's right end and the rest at its left.
+// Unlike NURBS Book A5.6 this needs no clamped ends, and each point is a
+// chain of convex combinations of the control points.
+int BSpline::bezierSegments(float *oPoints, float *oBreaks) const
+{
+    int p = order - 1;
+    int seg = 0;
+    float d[order * stride];
+
+    for(int span = p; span < cpCount; span++) {
+        float u0 = knots[span];
+        float u1 = knots[span + 1];
+        if(u1 <= u0) continue;
+
+        float *out = oPoints + seg * order * stride;
+        for(int b = 0; b <= p; b++) {
+            const float *cp = spanPoints(span, d);
+            if(cp != d)
+                for(int i = 0; i < order * stride; i++)
+                    d[i] = cp[i];
+
+            for(int r = 1; r <= p; r++) {
+                float t = (r <= b) ? u1 : u0;
+                for(int j = p; j >= r; j--) {
+                    int k = span - p + j;
+                    float a = (t - knots[k]) * invKnotDiff(order - r, k);
+                    float *dj = d + j * stride;
+                    float *dl = dj - stride;
+                    for(int i = 0; i < stride; i++)
+                        dj[i] = dl[i] + a * (dj[i] - dl[i]);
+                }
+            }
+            for(int i = 0; i < stride; i++)
+                out[b * stride + i] = d[p * stride + i];
+        }
 
-    for(int j = 0; j < (cpCount - 1); j++) {
-        float u0 = knots[j + n + 1];
-        float u1 = knots[j + 1];
-        float fn = (float(n) / (u0 - u1)) * basis(j + 1, n - 1, t);
-        int offset = j * stride;
-        for(int i = 0; i < stride; i++)
-            oPoint[i] += (cpBuffer[offset + stride + i] - cpBuffer[offset + i]) * fn;
+        if(oBreaks) oBreaks[seg] = u0;
+        seg++;
     }
+    if(oBreaks) oBreaks[seg] = knots[cpCount];
+    return seg;
 }
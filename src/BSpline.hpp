@@ -9,26 +9,127 @@
 #define BSpline_hpp
 
 #include <stdio.h>
+#include <vector>
+
+#include "Allocator.hpp"
+#include "Simd.hpp"
 
 class BSpline
 {
+    public:
+        enum KnotClass
+        {
+            GeneralKnots,
+            UniformKnots,
+            ClampedUniformKnots
+        };
+
     public:
         float *cpBuffer;
-        float *knots;
+        // read-only view of the knot buffer; change knots through init or setKnots
+        const float *knots;
+        // planar control points, used instead of cpBuffer when set; the
+        // evaluation paths read them in place
+        float *planes;
+        int planePitch;
         int stride;
         int maxCPCount;
         int order;
         int cpCount;
+        KnotClass knotClass;
+        float knotSpacing;
+        bool cubicKernel;
+        // backs the internal tables; the heap unless one was given
+        Allocator *allocator;
+        // bumped by init, setKnots, usePlanar and touch; derived caches compare against it
+        unsigned revision;
 
     public:
-        BSpline(float *iCPBuffer, float *iKnotBuffer, int iMaxCount, int iOrder = 4);
+        BSpline(float *iCPBuffer, float *iKnotBuffer, int iMaxCount, int iOrder = 4, Allocator *iAllocator = 0);
+        BSpline(const BSpline &) = default;
+        BSpline(BSpline &&) = default;
+        virtual ~BSpline() { }
+
+        BSpline &operator=(const BSpline &) = default;
+        BSpline &operator=(BSpline &&) = default;
 
         virtual void init(int iStride, int iCPCount);
+        virtual bool init(int iStride, int iCPCount, const float *iKnots);
+        // Replaces the cpCount + order knots and rebuilds the tables derived
+        // from them. Returns false, leaving the spline unchanged, on knots init rejects.
+        bool setKnots(const float *iKnots) { return init(stride, cpCount, iKnots); }
+        // call after writing control points so derived caches see the change
+        void touch() { revision++; }
+
+        void usePlanar(float *iPlanes, int iPitch);
+        void useInterleaved() { usePlanar(0, 0); }
+        const float *spanPoints(int iSpan, float *iScratch) const;
+
+        float clamp(float t) const;
+        bool isUniformSpan(int iSpan) const { return (iSpan >= uniformFirst) && (iSpan <= uniformLast); }
+
+        // 1 / (knots[i + k] - knots[i]) for levels 1 <= k < order, 0 for empty spans
+        float invKnotDiff(int k, int i) const { return invKnotDiffs[(k - 1) * tableStride + i]; }
+
+        float basis(int i, int k, float t) const;
+
+        int findSpan(float t, int iHint = -1) const;
+        void basisFuns(int iSpan, float t, int iDegree, float *oN) const;
+        void evalWeights(int iSpan, float t, float *oW) const;
+        void derivWeights(int iSpan, float t, float *oW) const;
+        void dersBasisFuns(int iSpan, float t, int n, float *oDers) const;
+        void deBoor(int iSpan, float t, float *oPoint) const;
+
+        void spanBasis(int iSpan, float *oBasis) const;
+        void spanCoefficients(int iSpan, float *oCoeffs) const;
+
+        void eval(float t, float *oPoint) const;
+        void deriv(float t, float *oPoint) const;
+        void evalDerivs(float t, int nDerivs, float *out) const;
+
+        void evalBatch(const float *ts, int n, float *out) const;
+        void derivBatch(const float *ts, int n, float *out) const;
+
+        // Knot insertion without changing the curve: u inserted r times
+        // (Boehm, NURBS Book A5.1) or a sorted list of knots (Oslo, A5.4).
+        // Both work on interleaved control points, grow through
+        // reserveCPs, and return false, leaving the spline unchanged, if
+        // the points are planar, capacity runs out, a knot falls outside
+        // [knots[order - 1], knots[cpCount]) or would repeat more than order - 1 times.
+        bool insertKnot(float u, int r = 1);
+        bool refineKnots(const float *iKnots, int iCount);
+
+        // Bezier form of the non-empty spans. Segment s has order control
+        // points at oPoints + s * order * stride and covers
+        // [oBreaks[s], oBreaks[s + 1]]. Returns the segment count.
+        int segmentCount() const;
+        int bezierSegments(float *oPoints, float *oBreaks = 0) const;
+
+        // Makes room for iCPCount control points and knots. Caller buffers
+        // cannot grow; OwningBSpline reallocates.
+        virtual bool reserveCPs(int iCPCount) { return iCPCount <= maxCPCount; }
+
+    protected:
+        bool validKnots(int iCPCount, const float *iKnots) const;
+        void updateKnots();
+        void classifyKnots();
+        const float *cubicMatrix(int iSpan, bool &oMirror) const;
+        void cubicWeights(int iSpan, float t, float *oW) const;
+        void cubicDerivWeights(int iSpan, float t, float *oW) const;
+        void spanSum(WeightedSumFn iSum, int iSpan, const float *iWeights, float *oOut) const;
+        void batch(const float *ts, int n, bool iDeriv, float *out) const;
+
+    protected:
+        float *knotBuffer;
 
-        float basis(int i, int k, float t);
+        int tableStride;
+        std::vector<float, StdAllocator<float> > invKnotDiffs;
 
-        void eval(float t, float *oPoint);
-        void deriv(float t, float *oPoint);
+        float invKnotSpacing;
+        int uniformFirst;
+        int uniformLast;
+        // power basis of a uniform span, laid out as spanBasis
+        std::vector<float, StdAllocator<float> > uniformBasis;
 };
 
 #endif /* BSpline_hpp */
@@ -0,0 +1,61 @@
+//
+//  BSplineCursor.cpp
+//  BSpline
+//
+
+#include "BSplineCursor.hpp"
+#include "Simd.hpp"
+
+BSplineCursor::BSplineCursor(const BSpline &iSpline)
+: spline(iSpline), time(0.0), span(-1), u0(0.0), u1(0.0), invH(0.0), x(0.0), coeffs(iSpline.order * iSpline.stride, 0.0f, StdAllocator<float>(iSpline.allocator))
+{ }
+
+void BSplineCursor::load(int iSpan)
+{
+    span = iSpan;
+    u0 = spline.knots[span];
+    u1 = spline.knots[span + 1];
+    invH = spline.invKnotDiff(1, span);
+    spline.spanCoefficients(span, &coeffs[0]);
+}
+
+void BSplineCursor::seek(float t)
+{
+    t = spline.clamp(t);
+    time = t;
+
+    int last = spline.cpCount - 1;
+    if((span < 0) || (t < u0)) {
+        load(spline.findSpan(t, span));
+    } else if((t >= u1) && (span < last)) {
+        // step over the following spans, skipping repeated knots
+        int s = span + 1;
+        while((s < last) && (t >= spline.knots[s + 1]))
+            s++;
+        // the domain end belongs to the last non-empty span
+        while(spline.knots[s + 1] == spline.knots[s])
+            s--;
+        load(s);
+    }
+    x = (t - u0) * invH;
+}
+
+void BSplineCursor::eval(float *oPoint) const
+{
+    int order = spline.order;
+    float xk[order];
+    xk[0] = 1.0;
+    for(int k = 1; k < order; k++)
+        xk[k] = xk[k - 1] * x;
+    weightedSum(&coeffs[0], spline.stride, xk, order, spline.stride, oPoint);
+}
+
+void BSplineCursor::deriv(float *oPoint) const
+{
+    int p = spline.order - 1;
+    float w[p];
+    float xk = invH;
+    for(int k = 1; k <= p; k++, xk *= x)
+        w[k - 1] = float(k) * xk;
+    weightedSum(&coeffs[spline.stride], spline.stride, w, p, spline.stride, oPoint);
+}
@@ -0,0 +1,44 @@
+//
+//  BSplineCursor.hpp
+//  BSpline
+//
+
+#ifndef BSplineCursor_hpp
+#define BSplineCursor_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "BSpline.hpp"
+
+// Sequential evaluator over a BSpline. Caches the current span and its
+// power-basis coefficients, so queries within a span cost O(order * stride)
+// and moving forward into the next span only rebuilds the coefficients.
+class BSplineCursor
+{
+    public:
+        BSplineCursor(const BSpline &iSpline);
+
+        void seek(float t);
+        void advance(float dt) { seek(time + dt); }
+
+        void eval(float *oPoint) const;
+        void deriv(float *oPoint) const;
+
+    protected:
+        void load(int iSpan);
+
+    public:
+        const BSpline &spline;
+        float time;
+
+    protected:
+        int span;
+        float u0;
+        float u1;
+        float invH;
+        float x;
+        std::vector<float, StdAllocator<float> > coeffs;
+};
+
+#endif /* BSplineCursor_hpp */
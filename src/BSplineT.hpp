@@ -0,0 +1,201 @@
+//
+//  BSplineT.hpp
+//  BSpline
+//
+
+#ifndef BSplineT_hpp
+#define BSplineT_hpp
+
+#include <stdio.h>
+#include <math.h>
+
+#include "KnotSpan.hpp"
+
+// Compile-time unrolling helpers for BSplineT.
+namespace BSplineDetail
+{
+    template<int N>
+    struct Unroll
+    {
+        template<typename F>
+        static inline void apply(const F &f) { Unroll<N - 1>::apply(f); f(N - 1); }
+    };
+
+    template<>
+    struct Unroll<0>
+    {
+        template<typename F>
+        static inline void apply(const F &) { }
+    };
+
+    // Inner loop of NURBS Book A2.2 for r = 0 .. R - 1 at level J.
+    template<int J, int R>
+    struct BasisInner
+    {
+        template<typename Scalar>
+        static inline void apply(Scalar *n, const Scalar *left, const Scalar *right, Scalar &saved)
+        {
+            BasisInner<J, R - 1>::apply(n, left, right, saved);
+            Scalar temp = n[R - 1] / (right[R] + left[J - R + 1]);
+            n[R - 1] = saved + right[R] * temp;
+            saved = left[J - R + 1] * temp;
+        }
+    };
+
+    template<int J>
+    struct BasisInner<J, 0>
+    {
+        template<typename Scalar>
+        static inline void apply(Scalar *, const Scalar *, const Scalar *, Scalar &) { }
+    };
+
+    // Outer loop of A2.2 for levels 1 .. J.
+    template<int J>
+    struct BasisOuter
+    {
+        template<typename Scalar>
+        static inline void apply(Scalar *n, const Scalar *knots, int span, Scalar t, Scalar *left, Scalar *right)
+        {
+            BasisOuter<J - 1>::apply(n, knots, span, t, left, right);
+            left[J] = t - knots[span + 1 - J];
+            right[J] = knots[span + J] - t;
+            Scalar saved = 0.0;
+            BasisInner<J, J>::apply(n, left, right, saved);
+            n[J] = saved;
+        }
+    };
+
+    template<>
+    struct BasisOuter<0>
+    {
+        template<typename Scalar>
+        static inline void apply(Scalar *n, const Scalar *, int, Scalar, Scalar *, Scalar *) { n[0] = 1.0; }
+    };
+}
+
+// Fixed order and dimension counterpart of BSpline. Control points and knots
+// use the same non-owning layout: Dim scalars per control point, cpCount + Order knots.
+template<int Order, int Dim, typename Scalar = float>
+class BSplineT
+{
+    static_assert(Order >= 2, "BSplineT needs at least a linear spline");
+
+    public:
+        static constexpr int order = Order;
+        static constexpr int degree = Order - 1;
+        static constexpr int stride = Dim;
+
+        static constexpr int knotCount(int iCPCount) { return iCPCount + Order; }
+        static constexpr int spanCount(int iCPCount) { return iCPCount - Order + 1; }
+
+        // Knot i of the clamped uniform layout that init builds.
+        static constexpr Scalar uniformKnot(int i, int iCPCount)
+        {
+            return (i < Order) ? Scalar(0) : ((i < iCPCount) ? Scalar(i - Order + 1) : Scalar(iCPCount - Order + 1));
+        }
+
+    public:
+        Scalar *cpBuffer;
+        Scalar *knots;
+        int maxCPCount;
+        int cpCount;
+        bool uniform;
+
+    public:
+        BSplineT(Scalar *iCPBuffer, Scalar *iKnotBuffer, int iMaxCount)
+        : cpBuffer(iCPBuffer), knots(iKnotBuffer), maxCPCount(iMaxCount), cpCount(0), uniform(false)
+        { }
+
+        void init(int iCPCount)
+        {
+            cpCount = iCPCount;
+            int n = knotCount(cpCount);
+            for(int i = 0; i < n; i++)
+                knots[i] = uniformKnot(i, cpCount);
+            uniform = true;
+        }
+
+        inline int findSpan(Scalar t, int iHint = -1) const
+        {
+            return findKnotSpan(knots, 1, degree, cpCount - 1, t, uniform ? Scalar(1) : Scalar(0), iHint);
+        }
+
+        template<int Degree>
+        inline void basisFuns(int iSpan, Scalar t, Scalar *oN) const
+        {
+            Scalar left[Degree + 1];
+            Scalar right[Degree + 1];
+            BSplineDetail::BasisOuter<Degree>::apply(oN, knots, iSpan, t, left, right);
+        }
+
+        inline Scalar clamp(Scalar t) const
+        {
+            Scalar tMax = knots[cpCount + degree];
+            if(t < Scalar(0)) t = Scalar(0);
+            if(t > tMax) t = tMax;
+            return t;
+        }
+
+        inline void eval(Scalar t, Scalar *oPoint) const
+        {
+            t = clamp(t);
+            int span = findSpan(t);
+            Scalar n[Order];
+            basisFuns<degree>(span, t, n);
+            accumulate(span - degree, n, oPoint);
+        }
+
+        inline void deriv(Scalar t, Scalar *oPoint) const
+        {
+            t = clamp(t);
+            int span = findSpan(t);
+            int first = span - degree;
+
+            Scalar nd[Order];
+            basisFuns<degree - 1>(span, t, nd);
+
+            Scalar w[Order];
+            w[0] = 0.0;
+            const Scalar *k = knots;
+            BSplineDetail::Unroll<degree>::apply([&](int j) {
+                Scalar fn = Scalar(degree) / (k[first + j + Order] - k[first + j + 1]) * nd[j];
+                w[j] -= fn;
+                w[j + 1] = fn;
+            });
+
+            accumulate(first, w, oPoint);
+        }
+
+        // |C'(t)|, the integrand of Parametizer's arc length.
+        inline Scalar speed(Scalar t) const
+        {
+            Scalar d[Dim];
+            deriv(t, d);
+            Scalar mag = 0.0;
+            BSplineDetail::Unroll<Dim>::apply([&](int i) { mag += d[i] * d[i]; });
+            return sqrt(mag);
+        }
+
+    protected:
+        inline void accumulate(int iFirst, const Scalar *iWeights, Scalar *oPoint) const
+        {
+            const Scalar *cp = cpBuffer + iFirst * Dim;
+            Scalar acc[Dim];
+            BSplineDetail::Unroll<Dim>::apply([&](int i) { acc[i] = cp[i] * iWeights[0]; });
+            BSplineDetail::Unroll<Order - 1>::apply([&](int j) {
+                const Scalar *row = cp + (j + 1) * Dim;
+                Scalar b = iWeights[j + 1];
+                BSplineDetail::Unroll<Dim>::apply([&](int i) { acc[i] += row[i] * b; });
+            });
+            BSplineDetail::Unroll<Dim>::apply([&](int i) { oPoint[i] = acc[i]; });
+        }
+};
+
+template<int Order, int Dim, typename Scalar> constexpr int BSplineT<Order, Dim, Scalar>::order;
+template<int Order, int Dim, typename Scalar> constexpr int BSplineT<Order, Dim, Scalar>::degree;
+template<int Order, int Dim, typename Scalar> constexpr int BSplineT<Order, Dim, Scalar>::stride;
+
+typedef BSplineT<4, 3, float> CubicBSpline3f;
+typedef BSplineT<4, 7, float> CubicBSpline7f;
+
+#endif /* BSplineT_hpp */
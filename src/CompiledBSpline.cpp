@@ -0,0 +1,88 @@
+//
+//  CompiledBSpline.cpp
+//  BSpline
+//
+
+#include "CompiledBSpline.hpp"
+#include "Simd.hpp"
+#include "KnotSpan.hpp"
+
+CompiledBSpline::CompiledBSpline()
+: order(0), stride(0), spanCount(0), uniform(false), invSpacing(0.0), breaks(), invWidths(), coeffs(), dcoeffs()
+{ }
+
+CompiledBSpline::CompiledBSpline(const BSpline &iSpline)
+: order(iSpline.order), stride(iSpline.stride), spanCount(0),
+  uniform(iSpline.knotClass != BSpline::GeneralKnots), invSpacing(uniform ? 1.0 / iSpline.knotSpacing : 0.0), breaks(), invWidths(), coeffs(), dcoeffs()
+{
+    int p = order - 1;
+    int rowSize = order * stride;
+    float c[rowSize];
+
+    for(int s = p; s < iSpline.cpCount; s++) {
+        float u0 = iSpline.knots[s];
+        float u1 = iSpline.knots[s + 1];
+        if(u1 <= u0) continue;
+
+        float invH = iSpline.invKnotDiff(1, s);
+        iSpline.spanCoefficients(s, c);
+        coeffs.insert(coeffs.end(), c, c + rowSize);
+        for(int k = 1; k <= p; k++) {
+            float f = float(k) * invH;
+            for(int i = 0; i < stride; i++)
+                dcoeffs.push_back(c[k * stride + i] * f);
+        }
+
+        breaks.push_back(u0);
+        invWidths.push_back(invH);
+        spanCount++;
+    }
+    if(spanCount)
+        breaks.push_back(iSpline.knots[iSpline.cpCount]);
+}
+
+int CompiledBSpline::findSpan(float t) const
+{
+    return findKnotSpan(&breaks[0], 1, 0, spanCount - 1, t, uniform ? invSpacing : 0.0f);
+}
+
+float CompiledBSpline::clamp(float t) const
+{
+    if(t < breaks[0]) return breaks[0];
+    if(t > breaks[spanCount]) return breaks[spanCount];
+    return t;
+}
+
+void CompiledBSpline::eval(float t, float *oPoint) const
+{
+    t = clamp(t);
+    int span = findSpan(t);
+    float x = (t - breaks[span]) * invWidths[span];
+
+    float xk[order];
+    xk[0] = 1.0;
+    for(int k = 1; k < order; k++)
+        xk[k] = xk[k - 1] * x;
+
+    weightedSum(&coeffs[span * order * stride], stride, xk, order, stride, oPoint);
+}
+
+void CompiledBSpline::deriv(float t, float *oPoint) const
+{
+    t = clamp(t);
+    int span = findSpan(t);
+    float x = (t - breaks[span]) * invWidths[span];
+    int p = order - 1;
+
+    float xk[order];
+    xk[0] = 1.0;
+    for(int k = 1; k < p; k++)
+        xk[k] = xk[k - 1] * x;
+
+    weightedSum(&dcoeffs[span * p * stride], stride, xk, p, stride, oPoint);
+}
+
+CompiledBSpline compile(const BSpline &iSpline)
+{
+    return CompiledBSpline(iSpline);
+}
@@ -0,0 +1,54 @@
+//
+//  CompiledBSpline.hpp
+//  BSpline
+//
+
+#ifndef CompiledBSpline_hpp
+#define CompiledBSpline_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "BSpline.hpp"
+
+// Immutable power-basis form of a BSpline. Each non-empty knot span stores
+// its polynomial coefficients in x = (t - start) / width, so evaluation is a
+// span lookup and a Horner-style sum. Safe to share between threads.
+class CompiledBSpline
+{
+    public:
+        CompiledBSpline();
+        CompiledBSpline(const BSpline &iSpline);
+
+        int findSpan(float t) const;
+
+        void eval(float t, float *oPoint) const;
+        void deriv(float t, float *oPoint) const;
+
+        int getOrder() const { return order; }
+        int getStride() const { return stride; }
+        int getSpanCount() const { return spanCount; }
+
+    protected:
+        float clamp(float t) const;
+
+    protected:
+        int order;
+        int stride;
+        int spanCount;
+        bool uniform;
+        float invSpacing;
+
+        // spanCount + 1 span boundaries
+        std::vector<float> breaks;
+        std::vector<float> invWidths;
+
+        // order * stride coefficients per span, x^k row k
+        std::vector<float> coeffs;
+        // (order - 1) * stride coefficients per span of d/dt
+        std::vector<float> dcoeffs;
+};
+
+CompiledBSpline compile(const BSpline &iSpline);
+
+#endif /* CompiledBSpline_hpp */
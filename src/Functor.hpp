@@ -13,7 +13,7 @@
 class Functor
 {
     public:
-        virtual float operator()(float t) = 0;
+        virtual float operator()(float t) const = 0;
 };
 
 #endif /* Functor_hpp */
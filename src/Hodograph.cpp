@@ -0,0 +1,55 @@
+//
+//  Hodograph.cpp
+//  BSpline
+//
+
+#include "Hodograph.hpp"
+
+bool hodograph(const BSpline &iSpline, OwningBSpline &oDeriv)
+{
+    int p = iSpline.order - 1;
+    if((p < 1) || (oDeriv.order != p)) return false;
+
+    int stride = iSpline.stride;
+    int count = iSpline.cpCount - 1;
+    if(!oDeriv.init(stride, count, iSpline.knots + 1)) return false;
+
+    for(int j = 0; j < count; j++) {
+        float scale = float(p) * iSpline.invKnotDiff(p, j + 1);
+        float *q = oDeriv.cpBuffer + j * stride;
+        for(int i = 0; i < stride; i++) {
+            float p0, p1;
+            if(iSpline.planes) {
+                p0 = iSpline.planes[i * iSpline.planePitch + j];
+                p1 = iSpline.planes[i * iSpline.planePitch + j + 1];
+            } else {
+                p0 = iSpline.cpBuffer[j * stride + i];
+                p1 = iSpline.cpBuffer[(j + 1) * stride + i];
+            }
+            q[i] = (p1 - p0) * scale;
+        }
+    }
+    return true;
+}
+
+Hodograph::Hodograph(const BSpline &iSpline, int iLevels, Allocator *iAllocator)
+: spline(iSpline), levelCount(iLevels), levels(), revision(0), built(false)
+{
+    if(levelCount > spline.order - 1) levelCount = spline.order - 1;
+    levels.reserve(levelCount);
+    for(int k = 1; k <= levelCount; k++)
+        levels.emplace_back(spline.stride, spline.order - k, iAllocator ? iAllocator : spline.allocator);
+}
+
+bool Hodograph::rebuild()
+{
+    built = false;
+    const BSpline *source = &spline;
+    for(int k = 0; k < levelCount; k++) {
+        if(!hodograph(*source, levels[k])) return false;
+        source = &levels[k];
+    }
+    revision = spline.revision;
+    built = true;
+    return true;
+}
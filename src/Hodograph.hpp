@@ -0,0 +1,50 @@
+//
+//  Hodograph.hpp
+//  BSpline
+//
+
+#ifndef Hodograph_hpp
+#define Hodograph_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "BSpline.hpp"
+#include "OwningBSpline.hpp"
+
+// Writes the derivative of iSpline into oDeriv as a spline of order - 1:
+// Q[j] = p * (P[j+1] - P[j]) / (knots[j+p+1] - knots[j+1]) on the knots with
+// the first and last removed. Returns false if iSpline is linear or has a
+// knot of full multiplicity inside its domain.
+bool hodograph(const BSpline &iSpline, OwningBSpline &oDeriv);
+
+// Cached chain of derivative splines of a BSpline, levels 1 .. levelCount.
+// Building is explicit: update() rebuilds when the source's revision has
+// moved (after init, setKnots, usePlanar or touch), and queries are const
+// plain evaluations of the lower order splines.
+class Hodograph
+{
+    public:
+        Hodograph(const BSpline &iSpline, int iLevels = 1, Allocator *iAllocator = 0);
+
+        bool update() { return valid() || rebuild(); }
+        bool rebuild();
+        bool valid() const { return built && (revision == spline.revision); }
+
+        // k-th derivative spline, 1 <= k <= levelCount
+        const BSpline &level(int k) const { return levels[k - 1]; }
+
+        void deriv(float t, float *oPoint) const { levels[0].eval(t, oPoint); }
+        void deriv(int k, float t, float *oPoint) const { levels[k - 1].eval(t, oPoint); }
+
+    public:
+        const BSpline &spline;
+        int levelCount;
+
+    protected:
+        std::vector<OwningBSpline> levels;
+        unsigned revision;
+        bool built;
+};
+
+#endif /* Hodograph_hpp */
@@ -0,0 +1,82 @@
+//
+//  KnotSpan.hpp
+//  BSpline
+//
+
+#ifndef KnotSpan_hpp
+#define KnotSpan_hpp
+
+#include <stdio.h>
+
+// Knot span search (NURBS Book A2.1) shared by BSpline, BSplineT,
+// CompiledBSpline, SpanPackedBSpline and SplineBank. Knot i is
+// iKnots[i * iStep], so a lane of strided knots searches in place; the
+// knots are nondecreasing and the spans searched are lo .. hi, with
+// iKnots[lo] < iKnots[hi + 1]. A list of span breakpoints works the same
+// way with lo = 0 and hi = span count - 1.
+
+// t at or past the domain end belongs to the last non-empty span, and t
+// before iKnots[lo + 1] to span lo. Returns true with oSpan set in those cases.
+template<typename Scalar>
+inline bool spanAtEnds(const Scalar *iKnots, int iStep, int lo, int hi, Scalar t, int &oSpan)
+{
+    if(t >= iKnots[(hi + 1) * iStep]) {
+        while(iKnots[hi * iStep] == iKnots[(hi + 1) * iStep])
+            hi--;
+        oSpan = hi;
+        return true;
+    }
+    if(t < iKnots[(lo + 1) * iStep]) {
+        oSpan = lo;
+        return true;
+    }
+    return false;
+}
+
+// Span holding t when the knots from lo on lie 1 / iInvSpacing apart.
+template<typename Scalar>
+inline int latticeSpan(const Scalar *iKnots, int iStep, int lo, int hi, Scalar t, Scalar iInvSpacing)
+{
+    int span = lo + int((t - iKnots[lo * iStep]) * iInvSpacing);
+    return (span > hi) ? hi : span;
+}
+
+// iHint, a span found for a nearby t, or the span after it if either holds
+// t; otherwise -1, with ioLo raised past iHint when t lies beyond it.
+template<typename Scalar>
+inline int hintedSpan(const Scalar *iKnots, int iStep, int &ioLo, int hi, Scalar t, int iHint)
+{
+    if((iHint < ioLo) || (iHint > hi) || (iKnots[iHint * iStep] > t)) return -1;
+    if(t < iKnots[(iHint + 1) * iStep]) return iHint;
+    if((iHint < hi) && (t < iKnots[(iHint + 2) * iStep])) return iHint + 1;
+    ioLo = iHint + 1;
+    return -1;
+}
+
+// Largest span in lo .. hi with iKnots[span] <= t, which skips repeated knots.
+template<typename Scalar>
+inline int searchSpan(const Scalar *iKnots, int iStep, int lo, int hi, Scalar t)
+{
+    while(lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if(iKnots[mid * iStep] <= t)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+// The whole lookup: ends, then the lattice when iInvSpacing > 0, then the
+// hint, then binary search.
+template<typename Scalar>
+inline int findKnotSpan(const Scalar *iKnots, int iStep, int lo, int hi, Scalar t, Scalar iInvSpacing = 0, int iHint = -1)
+{
+    int span;
+    if(spanAtEnds(iKnots, iStep, lo, hi, t, span)) return span;
+    if(iInvSpacing > 0) return latticeSpan(iKnots, iStep, lo, hi, t, iInvSpacing);
+    span = hintedSpan(iKnots, iStep, lo, hi, t, iHint);
+    return (span >= 0) ? span : searchSpan(iKnots, iStep, lo, hi, t);
+}
+
+#endif /* KnotSpan_hpp */
@@ -7,11 +7,11 @@
 
 #include "Legendre.hpp"
 
-extern int ndx[];
-extern double wgts[];
-extern double absc[];
+extern const int ndx[];
+extern const double wgts[];
+extern const double absc[];
 
-double legendreIntegrate(int order, double from, double to, Functor &f)
+double legendreIntegrate(int order, double from, double to, const Functor &f)
 {
     double r = 0.0;
     
@@ -24,7 +24,7 @@ double legendreIntegrate(int order, double from, double to, Functor &f)
     return 0.5 * (to - from) * r;
 }
 
-int ndx[] = {
+const int ndx[] = {
     0,
     0,
     0,
@@ -92,7 +92,7 @@ int ndx[] = {
     2015
 };
 
-double wgts[] = {
+const double wgts[] = {
     1.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000,
     1.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000,
     
@@ -2236,7 +2236,7 @@ double wgts[] = {
     0.0017832807216964329472960791449719331799593472719279556695308063655858546954239803486698215802150348282744786016134857283616955449868451969230490863774274598030023211055562492709717566919237924255297982774711177411074145151155610163293142044147991553384925940046957893721166251082473659733
 };
 
-double absc[] = {
+const double absc[] = {
     -0.5773502691896257645091487805019574556476017512701268760186023264839776723029333456937153955857495252252087138051355676766566483649996508262705518373647912161760310773007685273559916067003615583077550051041144223011076288835574182229739459904090157105534559538626730166621791266197964892168,
     0.5773502691896257645091487805019574556476017512701268760186023264839776723029333456937153955857495252252087138051355676766566483649996508262705518373647912161760310773007685273559916067003615583077550051041144223011076288835574182229739459904090157105534559538626730166621791266197964892168,
 
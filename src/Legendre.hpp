@@ -11,6 +11,6 @@
 #include <stdio.h>
 #include "Functor.hpp"
 
-double legendreIntegrate(int order, double from, double to, Functor &f);
+double legendreIntegrate(int order, double from, double to, const Functor &f);
 
 #endif /* Legendre_hpp */
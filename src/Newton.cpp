@@ -8,7 +8,7 @@
 #include "Newton.hpp"
 #include "Functor.hpp"
 
-double newtonSolve(double tgt, double hint, Functor &f, Functor &d, int maxSteps, double tol, double epsilon)
+double newtonSolve(double tgt, double hint, const Functor &f, const Functor &d, int maxSteps, double tol, double epsilon)
 {
     double x0 = hint;
     double x1 = hint;
@@ -12,6 +12,6 @@
 #include <math.h>
 #include "Functor.hpp"
 
-double newtonSolve(double tgt, double hint, Functor &f, Functor &d, int maxSteps = 100, double tol = 0.0001, double epsilon = 0.0001);
+double newtonSolve(double tgt, double hint, const Functor &f, const Functor &d, int maxSteps = 100, double tol = 0.0001, double epsilon = 0.0001);
 
 #endif /* Newton_hpp */
@@ -0,0 +1,115 @@
+//
+//  OwningBSpline.cpp
+//  BSpline
+//
+
+#include "OwningBSpline.hpp"
+
+#include <new>
+#include <utility>
+
+OwningBSpline::OwningBSpline(int iStride, int iOrder, Allocator *iAllocator)
+: BSpline(0, 0, 0, iOrder, iAllocator)
+{
+    stride = iStride;
+}
+
+OwningBSpline::OwningBSpline(OwningBSpline &&iOther)
+: BSpline(std::move(iOther))
+{
+    iOther.cpBuffer = 0;
+    iOther.knots = iOther.knotBuffer = 0;
+    iOther.maxCPCount = 0;
+    iOther.cpCount = 0;
+}
+
+OwningBSpline::~OwningBSpline()
+{
+    release();
+}
+
+OwningBSpline &OwningBSpline::operator=(OwningBSpline &&iOther)
+{
+    if(this != &iOther) {
+        release();
+        BSpline::operator=(std::move(iOther));
+        iOther.cpBuffer = 0;
+        iOther.knots = iOther.knotBuffer = 0;
+        iOther.maxCPCount = 0;
+        iOther.cpCount = 0;
+    }
+    return *this;
+}
+
+void OwningBSpline::release()
+{
+    allocator->deallocate(cpBuffer, size_t(maxCPCount) * size_t(stride) * sizeof(float));
+    allocator->deallocate(knotBuffer, size_t(maxCPCount + order) * sizeof(float));
+    cpBuffer = 0;
+    knots = knotBuffer = 0;
+    maxCPCount = 0;
+}
+
+void OwningBSpline::reallocate(int iStride, int iCapacity, bool iKeep)
+{
+    size_t cpSize = size_t(iCapacity) * size_t(iStride) * sizeof(float);
+    float *cp = (float *)allocator->allocate(cpSize, 64);
+    float *kn = cp ? (float *)allocator->allocate(size_t(iCapacity + order) * sizeof(float), 64) : 0;
+    if(!kn) {
+        // leave the current arrays as they were
+        allocator->deallocate(cp, cpSize);
+        throw std::bad_alloc();
+    }
+
+    if(iKeep && (cpCount > 0)) {
+        int count = (cpCount < iCapacity) ? cpCount : iCapacity;
+        for(int i = 0; i < count * stride; i++)
+            cp[i] = cpBuffer[i];
+        for(int i = 0; i < count + order; i++)
+            kn[i] = knots[i];
+    }
+
+    release();
+    cpBuffer = cp;
+    knots = knotBuffer = kn;
+    stride = iStride;
+    maxCPCount = iCapacity;
+}
+
+void OwningBSpline::reserve(int iCPCount)
+{
+    if(iCPCount > maxCPCount)
+        reallocate(stride, iCPCount, true);
+}
+
+void OwningBSpline::resize(int iCPCount)
+{
+    reserve(iCPCount);
+    BSpline::init(stride, iCPCount);
+}
+
+void OwningBSpline::shrinkToFit()
+{
+    if(cpCount < maxCPCount)
+        reallocate(stride, cpCount, true);
+}
+
+void OwningBSpline::init(int iStride, int iCPCount)
+{
+    if(iStride != stride)
+        reallocate(iStride, iCPCount, false);
+    else
+        reserve(iCPCount);
+    BSpline::init(iStride, iCPCount);
+}
+
+bool OwningBSpline::init(int iStride, int iCPCount, const float *iKnots)
+{
+    // reject before reallocating so a failed init leaves the spline as it was
+    if(!validKnots(iCPCount, iKnots)) return false;
+    if(iStride != stride)
+        reallocate(iStride, iCPCount, false);
+    else
+        reserve(iCPCount);
+    return BSpline::init(iStride, iCPCount, iKnots);
+}
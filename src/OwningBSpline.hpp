@@ -0,0 +1,49 @@
+//
+//  OwningBSpline.hpp
+//  BSpline
+//
+
+#ifndef OwningBSpline_hpp
+#define OwningBSpline_hpp
+
+#include <stdio.h>
+
+#include "BSpline.hpp"
+#include "Allocator.hpp"
+
+// BSpline that owns 64-byte aligned control point and knot arrays, drawn
+// from its allocator along with the internal tables. maxCPCount tracks the
+// reserved capacity. Moves hand the arrays over without copying. Growing
+// throws std::bad_alloc, keeping the current arrays, if the allocator fails.
+class OwningBSpline: public BSpline
+{
+    public:
+        OwningBSpline(int iStride, int iOrder = 4, Allocator *iAllocator = 0);
+        OwningBSpline(OwningBSpline &&iOther);
+        ~OwningBSpline();
+
+        OwningBSpline &operator=(OwningBSpline &&iOther);
+
+        // Grows capacity to iCPCount control points, keeping the current ones.
+        void reserve(int iCPCount);
+        // Sets the control point count, keeping existing points, and lays out uniform knots.
+        void resize(int iCPCount);
+        void shrinkToFit();
+
+        int capacity() const { return maxCPCount; }
+
+        virtual bool reserveCPs(int iCPCount) { reserve(iCPCount); return true; }
+
+        virtual void init(int iStride, int iCPCount);
+        virtual bool init(int iStride, int iCPCount, const float *iKnots);
+
+    protected:
+        void reallocate(int iStride, int iCapacity, bool iKeep);
+        void release();
+
+    private:
+        OwningBSpline(const OwningBSpline &);
+        OwningBSpline &operator=(const OwningBSpline &);
+};
+
+#endif /* OwningBSpline_hpp */
@@ -10,48 +10,446 @@
 #include "Legendre.hpp"
 #include "Newton.hpp"
 
-void Parametizer::init()
+// Gauss-Legendre order for table subintervals, and the node cap per span
+static const int tableRule = 16;
+static const int maxTableIntervals = 1024;
+// first and largest Chebyshev sample counts per span
+static const int minChebyshev = 8;
+static const int maxChebyshev = 256;
+
+// Cubic Hermite interpolation on [x0, x0 + h].
+static inline float hermite(float x0, float h, float y0, float y1, float m0, float m1, float x)
+{
+    float u = (x - x0) / h;
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return (2.0f * u3 - 3.0f * u2 + 1.0f) * y0 + (u3 - 2.0f * u2 + u) * h * m0 + (3.0f * u2 - 2.0f * u3) * y1 + (u3 - u2) * h * m1;
+}
+
+// Fritsch-Carlson: scales the slopes of every interval back into the
+// circle of radius 3 about the secant, which keeps the Hermite interpolant
+// monotone. x increasing, y nondecreasing.
+static void fritschCarlson(const double *x, const double *y, double *m, int n)
 {
+    for(int k = 0; k + 1 < n; k++) {
+        double delta = (y[k + 1] - y[k]) / (x[k + 1] - x[k]);
+        if(delta <= 0.0) {
+            m[k] = 0.0;
+            m[k + 1] = 0.0;
+            continue;
+        }
+        double a = m[k] / delta;
+        double b = m[k + 1] / delta;
+        double r = a * a + b * b;
+        if(r > 9.0) {
+            double tau = 3.0 / sqrt(r);
+            m[k] = tau * a * delta;
+            m[k + 1] = tau * b * delta;
+        }
+    }
+}
+
+// Chebyshev coefficients of f[k] = F(cos(pi (k + 1/2) / n)), with c[0]
+// already halved so that F = sum c[j] T_j.
+static void chebyshevCoeffs(const double *f, int n, double *oC)
+{
+    for(int j = 0; j < n; j++) {
+        double sum = 0.0;
+        for(int k = 0; k < n; k++)
+            sum += f[k] * cos(M_PI * j * (k + 0.5) / n);
+        oC[j] = sum * 2.0 / n;
+    }
+    oC[0] *= 0.5;
+}
+
+// Fewest leading coefficients whose dropped tail sums to at most iTol.
+static int chebyshevTrim(const double *c, int n, double iTol)
+{
+    double tail = 0.0;
+    int m = n;
+    while((m > 1) && (tail + fabs(c[m - 1]) <= iTol))
+        tail += fabs(c[--m]);
+    return m;
+}
+
+// sum c[j] T_j(u)
+static inline float clenshaw(const float *c, int n, float u)
+{
+    float b1 = 0.0f, b2 = 0.0f;
+    for(int k = n - 1; k >= 1; k--) {
+        float b0 = c[k] + 2.0f * u * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+    return c[0] + u * b1 - b2;
+}
+
+// d/du sum c[j] T_j(u) = sum j c[j] U_{j-1}(u)
+static inline float clenshawDeriv(const float *c, int n, float u)
+{
+    float b1 = 0.0f, b2 = 0.0f;
+    for(int k = n - 1; k >= 1; k--) {
+        float b0 = float(k) * c[k] + 2.0f * u * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+    return b1;
+}
+
+void Parametizer::init(Mode iMode, double iTolerance)
+{
+    mode = iMode;
+    tolerance = iTolerance;
+    useHodograph = hodograph && hodograph->valid();
     length = 0.0;
     int start = spline.order - 1;
     int end = spline.cpCount;
     
     spanLengths.clear();
+    spanLengths.reserve(end - start);
+    arcPrefix.clear();
+    arcPrefix.reserve(end - start + 1);
+    arcPrefix.push_back(0.0);
+    tableStart.clear();
+    tableT.clear();
+    tableS.clear();
+    tableDS.clear();
+    tableDT.clear();
+    chebStart.clear();
+    chebTStart.clear();
+    chebS.clear();
+    chebT.clear();
+    
+    // Table nodes and Chebyshev coefficients are staged on the heap and
+    // copied into the members once their count is known, so a monotonic
+    // allocator holds only the result.
+    vector<int> starts, startsT;
+    vector<float> nodeT, nodeS, nodeDS, nodeDT;
+    
     for(int i = start; i < end; i++) {
-        float t0 = spline.knots[i];
-        float t1 = spline.knots[i+1];
-        MagDFunctor d(*this);
-        float spanLength = float(legendreIntegrate(64, t0, t1, d));
+        float spanLength;
+        if(mode == Table) {
+            starts.push_back(int(nodeT.size()));
+            buildTable(i - start, nodeT, nodeS, nodeDS, nodeDT);
+            spanLength = nodeS.back();
+        } else {
+            float t0 = spline.knots[i];
+            float t1 = spline.knots[i+1];
+            MagDFunctor d(*this);
+            spanLength = float(legendreIntegrate(64, t0, t1, d));
+        }
         spanLengths.push_back(spanLength);
         length += spanLength;
+        arcPrefix.push_back(length);
+        if(mode == Chebyshev) {
+            starts.push_back(int(nodeS.size()));
+            startsT.push_back(int(nodeT.size()));
+            fitChebyshev(i - start, nodeS, nodeT);
+        }
+    }
+    if(mode == Table) {
+        starts.push_back(int(nodeT.size()));
+        tableStart.assign(starts.begin(), starts.end());
+        tableT.assign(nodeT.begin(), nodeT.end());
+        tableS.assign(nodeS.begin(), nodeS.end());
+        tableDS.assign(nodeDS.begin(), nodeDS.end());
+        tableDT.assign(nodeDT.begin(), nodeDT.end());
+    }
+    if(mode == Chebyshev) {
+        starts.push_back(int(nodeS.size()));
+        startsT.push_back(int(nodeT.size()));
+        chebStart.assign(starts.begin(), starts.end());
+        chebTStart.assign(startsT.begin(), startsT.end());
+        chebS.assign(nodeS.begin(), nodeS.end());
+        chebT.assign(nodeT.begin(), nodeT.end());
+    }
+}
+
+// Fits s(t) and then t(s) on span iSeg from 8, 16, 32 ... samples at
+// Chebyshev points until the coefficients have decayed enough that the
+// upper half can be dropped within half the tolerance, then keeps only the
+// coefficients needed. Requiring the whole upper half, rather than the last
+// few, guards against coefficients that are small only by coincidence. s at
+// the sample points is integrated node to node; t at the sample points comes
+// from a warm-started Newton sweep. The t(s) tolerance is scaled by the
+// span's mean speed to stay in arc length units. The coefficients are
+// appended to ioS and ioT.
+void Parametizer::fitChebyshev(int iSeg, vector<float> &ioS, vector<float> &ioT)
+{
+    int i = iSeg + spline.order - 1;
+    double t0 = spline.knots[i];
+    double h = spline.knots[i + 1] - t0;
+    double len = spanLengths[iSeg];
+    
+    if((h <= 0.0) || (len <= 0.0)) {
+        ioS.push_back(0.0f);
+        ioT.push_back(0.0f);
+        return;
+    }
+    
+    MagDFunctor d(*this);
+    double f[maxChebyshev];
+    double c[maxChebyshev];
+    
+    int n, m;
+    for(n = minChebyshev; ; n *= 2) {
+        // sample points rise in t as k falls
+        double tp = t0;
+        double sp = 0.0;
+        for(int k = n - 1; k >= 0; k--) {
+            double t = t0 + 0.5 * h * (1.0 + cos(M_PI * (k + 0.5) / n));
+            sp += legendreIntegrate(tableRule, tp, t, d);
+            tp = t;
+            f[k] = sp;
+        }
+        chebyshevCoeffs(f, n, c);
+        m = chebyshevTrim(c, n, 0.5 * tolerance);
+        if((2 * m <= n) || (n >= maxChebyshev)) break;
+    }
+    for(int j = 0; j < m; j++)
+        ioS.push_back(float(c[j]));
+    
+    double tolT = 0.5 * tolerance * h / len;
+    for(n = minChebyshev; ; n *= 2) {
+        double x = 0.0;
+        double s = 0.0;
+        for(int k = n - 1; k >= 0; k--) {
+            solveSegment(iSeg, 0.5 * len * (1.0 + cos(M_PI * (k + 0.5) / n)), x, s);
+            f[k] = x;
+        }
+        chebyshevCoeffs(f, n, c);
+        m = chebyshevTrim(c, n, tolT);
+        if((2 * m <= n) || (n >= maxChebyshev)) break;
+    }
+    for(int j = 0; j < m; j++)
+        ioT.push_back(float(c[j]));
+}
+
+float Parametizer::chebyshevArc(int iSeg, float t) const
+{
+    int i = iSeg + spline.order - 1;
+    float t0 = spline.knots[i];
+    float h = spline.knots[i + 1] - t0;
+    if(h <= 0.0f) return 0.0;
+    
+    float u = 2.0f * (t - t0) / h - 1.0f;
+    if(u < -1.0f) u = -1.0f;
+    if(u > 1.0f) u = 1.0f;
+    int base = chebStart[iSeg];
+    return clenshaw(&chebS[base], chebStart[iSeg + 1] - base, u);
+}
+
+float Parametizer::chebyshevTime(int iSeg, float iArc) const
+{
+    float t0 = spline.knots[iSeg + spline.order - 1];
+    float len = float(spanLengths[iSeg]);
+    if(len <= 0.0f) return t0;
+    
+    float u = 2.0f * iArc / len - 1.0f;
+    if(u < -1.0f) u = -1.0f;
+    if(u > 1.0f) u = 1.0f;
+    int base = chebTStart[iSeg];
+    return t0 + clenshaw(&chebT[base], chebTStart[iSeg + 1] - base, u);
+}
+
+float Parametizer::arcLengthDeriv(float t) const
+{
+    if(mode != Chebyshev) {
+        MagDFunctor d(*this);
+        return d(t);
     }
+    
+    int start = spline.order - 1;
+    t = spline.clamp(t);
+    int span = spline.findSpan(t);
+    int seg = span - start;
+    float h = spline.knots[span + 1] - spline.knots[span];
+    int base = chebStart[seg];
+    float u = 2.0f * (t - spline.knots[span]) / h - 1.0f;
+    return clenshawDeriv(&chebS[base], chebStart[seg + 1] - base, u) * 2.0f / h;
+}
+
+float Parametizer::timeForArcDeriv(float iArc) const
+{
+    if(mode != Chebyshev) {
+        float v = arcLengthDeriv(timeForArc(iArc));
+        return (v > 0.0f) ? 1.0f / v : 0.0f;
+    }
+    
+    if(iArc < 0.0f) iArc = 0.0f;
+    if(iArc > length) iArc = float(length);
+    int seg = spanForArc(iArc);
+    float len = float(spanLengths[seg]);
+    if(len <= 0.0f) return 0.0;
+    
+    float u = 2.0f * (iArc - float(arcPrefix[seg])) / len - 1.0f;
+    if(u < -1.0f) u = -1.0f;
+    if(u > 1.0f) u = 1.0f;
+    int base = chebTStart[seg];
+    return clenshawDeriv(&chebT[base], chebTStart[seg + 1] - base, u) * 2.0f / len;
+}
+
+// Samples span iSeg at 4, 8, 16 ... intervals until the interpolants of s(t)
+// and t(s) both stay within tolerance arc length at every interval midpoint.
+// Midpoints checked in one round become the new nodes of the next. The
+// nodes are appended to ioT, ioS, ioDS and ioDT; scratch is on the heap.
+void Parametizer::buildTable(int iSeg, vector<float> &ioT, vector<float> &ioS, vector<float> &ioDS, vector<float> &ioDT)
+{
+    int i = iSeg + spline.order - 1;
+    double t0 = spline.knots[i];
+    double t1 = spline.knots[i + 1];
+    if(t1 <= t0) {
+        ioT.push_back(float(t0));
+        ioS.push_back(0.0f);
+        ioDS.push_back(0.0f);
+        ioDT.push_back(0.0f);
+        return;
+    }
+    
+    MagDFunctor d(*this);
+    vector<double> t, s, ds, dt;
+    vector<double> tm, sm, dm;
+    t.reserve(maxTableIntervals + 1);
+    s.reserve(maxTableIntervals + 1);
+    ds.reserve(maxTableIntervals + 1);
+    dt.reserve(maxTableIntervals + 1);
+    tm.reserve(maxTableIntervals);
+    sm.reserve(maxTableIntervals);
+    dm.reserve(maxTableIntervals);
+    
+    int n = 4;
+    for(int k = 0; k <= n; k++) {
+        t.push_back(t0 + (t1 - t0) * k / n);
+        s.push_back(k ? s[k - 1] + legendreIntegrate(tableRule, t[k - 1], t[k], d) : 0.0);
+        ds.push_back(d(float(t[k])));
+    }
+    
+    for(;;) {
+        dt.resize(n + 1);
+        for(int k = 0; k <= n; k++)
+            dt[k] = 1.0 / ((ds[k] > 1.0e-30) ? ds[k] : 1.0e-30);
+        fritschCarlson(&t[0], &s[0], &ds[0], n + 1);
+        fritschCarlson(&s[0], &t[0], &dt[0], n + 1);
+        
+        tm.resize(n);
+        sm.resize(n);
+        dm.resize(n);
+        double err = 0.0;
+        for(int k = 0; k < n; k++) {
+            tm[k] = 0.5 * (t[k] + t[k + 1]);
+            sm[k] = s[k] + legendreIntegrate(tableRule, t[k], tm[k], d);
+            dm[k] = d(float(tm[k]));
+            
+            double es = fabs(hermite(t[k], t[k + 1] - t[k], s[k], s[k + 1], ds[k], ds[k + 1], tm[k]) - sm[k]);
+            double et = 0.0;
+            if(s[k + 1] > s[k])
+                et = fabs(hermite(s[k], s[k + 1] - s[k], t[k], t[k + 1], dt[k], dt[k + 1], sm[k]) - tm[k]) * dm[k];
+            if(es > err) err = es;
+            if(et > err) err = et;
+        }
+        if((err <= tolerance) || (n >= maxTableIntervals)) break;
+        
+        // interleave the midpoints; slopes go back to the exact speeds
+        int m = 2 * n;
+        t.resize(m + 1);
+        s.resize(m + 1);
+        ds.resize(m + 1);
+        for(int k = n; k >= 0; k--) {
+            t[2 * k] = t[k];
+            s[2 * k] = s[k];
+        }
+        for(int k = 0; k < n; k++) {
+            t[2 * k + 1] = tm[k];
+            s[2 * k + 1] = sm[k];
+        }
+        for(int k = 0; k <= m; k++)
+            ds[k] = (k & 1) ? dm[k >> 1] : d(float(t[k]));
+        n = m;
+    }
+    
+    for(int k = 0; k <= n; k++) {
+        ioT.push_back(float(t[k]));
+        ioS.push_back(float(s[k]));
+        ioDS.push_back(float(ds[k]));
+        ioDT.push_back(float(dt[k]));
+    }
+}
+
+float Parametizer::tableArc(int iSeg, float t) const
+{
+    int base = tableStart[iSeg];
+    int n = tableStart[iSeg + 1] - base - 1;
+    if(n < 1) return 0.0;
+    
+    const float *x = &tableT[base];
+    float h = (x[n] - x[0]) / float(n);
+    int k = int((t - x[0]) / h);
+    if(k < 0) k = 0;
+    if(k > n - 1) k = n - 1;
+    
+    const float *y = &tableS[base];
+    const float *m = &tableDS[base];
+    return hermite(x[k], x[k + 1] - x[k], y[k], y[k + 1], m[k], m[k + 1], t);
 }
 
-float Parametizer::arcLength(float t)
+float Parametizer::tableTime(int iSeg, float iArc) const
+{
+    int base = tableStart[iSeg];
+    int n = tableStart[iSeg + 1] - base - 1;
+    const float *x = &tableS[base];
+    const float *y = &tableT[base];
+    if((n < 1) || (x[n] <= 0.0f)) return y[0];
+    
+    if(iArc <= 0.0f) return y[0];
+    if(iArc >= x[n]) return y[n];
+    
+    // nodes are even in t, so arc is close to even too: guess, then walk
+    int k = int(iArc / x[n] * float(n));
+    if(k > n - 1) k = n - 1;
+    while((k > 0) && (x[k] > iArc))
+        k--;
+    while((k < n - 1) && (x[k + 1] <= iArc))
+        k++;
+    if(x[k + 1] <= x[k]) return y[k];
+    
+    const float *m = &tableDT[base];
+    return hermite(x[k], x[k + 1] - x[k], y[k], y[k + 1], m[k], m[k + 1], iArc);
+}
+
+float Parametizer::arcLength(float t) const
 {
     int start = spline.order - 1;
-    float arcLen = 0.0;
-    int i;
-    for(i = start; t > spline.knots[i]; i++)
-        arcLen += spanLengths[i - start];
+    t = spline.clamp(t);
+    int span = spline.findSpan(t);
+    float arcLen = float(arcPrefix[span - start]);
+    if(mode == Table) return arcLen + tableArc(span - start, t);
+    if(mode == Chebyshev) return arcLen + chebyshevArc(span - start, t);
     MagDFunctor d(*this);
-    return arcLen + float(legendreIntegrate(64, spline.knots[i], t, d));
+    return arcLen + float(legendreIntegrate(64, spline.knots[span], t, d));
 }
 
-float Parametizer::timeForArc(float iArc)
+float Parametizer::timeForArc(float iArc) const
 {
     if(iArc >= length) return spline.knots[spline.cpCount];
     
-    float len = 0.0;
-    
-    int i;
-    for(i = 0; (len + spanLengths[i]) < iArc; i++)
-        len += spanLengths[i];
+    int i = spanForArc(iArc);
+    float len = float(arcPrefix[i]);
     
+    if(mode == Table) return tableTime(i, iArc - len);
+    if(mode == Chebyshev) return chebyshevTime(i, iArc - len);
     return timeForSegmentArc(i, iArc - len);
 }
 
-float Parametizer::segmentArc(int iSeg, float t)
+// First span whose end reaches iArc. Knot uniformity says nothing about
+// how arc length is spread over the spans, so this is always a search.
+int Parametizer::spanForArc(double iArc) const
+{
+    int spans = int(spanLengths.size());
+    int i = int(lower_bound(arcPrefix.begin() + 1, arcPrefix.end(), iArc) - arcPrefix.begin()) - 1;
+    return (i < spans - 1) ? i : spans - 1;
+}
+
+float Parametizer::segmentArc(int iSeg, float t) const
 {
     float t0 = spline.knots[iSeg + spline.order - 1];
     
@@ -59,7 +457,7 @@ float Parametizer::segmentArc(int iSeg, float t)
     return legendreIntegrate(64, t0, t0 + t, d);
 }
 
-float Parametizer::segmentArcDeriv(int iSeg, float t)
+float Parametizer::segmentArcDeriv(int iSeg, float t) const
 {
     float t0 = spline.knots[iSeg + spline.order - 1];
     
@@ -67,45 +465,119 @@ float Parametizer::segmentArcDeriv(int iSeg, float t)
     return d(t0 + t);
 }
 
-float Parametizer::timeForSegmentArc(int iSeg, float iArc)
+float Parametizer::timeForSegmentArc(int iSeg, float iArc) const
+{
+    double x = 0.0;
+    double s = 0.0;
+    return solveSegment(iSeg, iArc, x, s);
+}
+
+// Newton on s(t) = iArc within span iSeg, starting from offset ioX past the
+// span start whose arc ioS is already known; both are left at the solution.
+// Each step integrates only between consecutive iterates and adds that to
+// the arc already known, with a Gauss-Legendre order scaled to the step's
+// share of the span, so a cold start pays for most of the quadrature in its
+// first step and the corrections cost a few evaluations each. Steps that
+// leave the bracket [lo, hi] around the root bisect instead. Stopping rules
+// match newtonSolve's defaults.
+float Parametizer::solveSegment(int iSeg, double iArc, double &ioX, double &ioS) const
 {
     int start = spline.order - 1;
-    float t0 = spline.knots[iSeg + start];
-    float hint = 0.0;
+    double t0 = spline.knots[iSeg + start];
+    double h = spline.knots[iSeg + start + 1] - t0;
+    
+    if(h <= 0.0) return float(t0);
+    
+    MagDFunctor d(*this);
+    double x = ioX;
+    double s = ioS;
+    double lo = 0.0;
+    double hi = h;
+    for(int step = 0; step < 100; step++) {
+        if(s < iArc)
+            lo = x;
+        else
+            hi = x;
+        
+        double v = d(float(t0 + x));
+        double x1 = (v > 0.0001) ? x + (iArc - s) / v : lo - 1.0;
+        if((x1 <= lo) || (x1 >= hi))
+            x1 = 0.5 * (lo + hi);
+        
+        double dx = x1 - x;
+        if(dx == 0.0) break;
+        int order = int(64.0 * fabs(dx) / h) + 4;
+        if(order > 64) order = 64;
+        s += legendreIntegrate(order, t0 + x, t0 + x1, d);
+        x = x1;
+        if(fabs(dx) / fabs(x1) < 0.0001) break;
+    }
     
-    SegArcFunctor f(*this, iSeg);
-    SegArcDFunctor d(*this, iSeg);
+    ioX = x;
+    ioS = s;
+    return float(t0 + x);
+}
+
+// One pass over the spans for nondecreasing targets: each solve starts from
+// the previous solution and the arc integrated up to it, so its first
+// Newton step is the previous t plus ds / |C'(t)|.
+void Parametizer::timesForArcs(const float *iArcs, int iCount, float *oTimes) const
+{
+    int spans = int(spanLengths.size());
+    int seg = 0;
+    double x = 0.0;
+    double s = 0.0;
     
-    return t0 + newtonSolve(iArc, hint, f, d);
+    for(int i = 0; i < iCount; i++) {
+        double arc = iArcs[i];
+        if(arc >= length) {
+            oTimes[i] = spline.knots[spline.cpCount];
+            continue;
+        }
+        
+        while((seg < spans - 1) && (arcPrefix[seg + 1] < arc)) {
+            seg++;
+            x = 0.0;
+            s = 0.0;
+        }
+        
+        double local = arc - arcPrefix[seg];
+        if(mode == Table)
+            oTimes[i] = tableTime(seg, float(local));
+        else if(mode == Chebyshev)
+            oTimes[i] = chebyshevTime(seg, float(local));
+        else
+            oTimes[i] = solveSegment(seg, local, x, s);
+    }
 }
 
-vector<float> Parametizer::parametizeLinear(int iCount)
+vector<float> Parametizer::parametizeLinear(int iCount) const
 {
     vector<float> times;
     
-    times.push_back(0.0);
-    float step = float(length) / float(iCount);
-    float arc = step;
-    while(iCount--) {
-        times.push_back(timeForArc(arc));
-        arc += step;
-    }
+    times.resize(iCount + 1);
+    times[0] = spline.knots[spline.order - 1];
+    double step = length / double(iCount);
+    for(int i = 1; i < iCount; i++)
+        times[i] = float(step * i);
+    timesForArcs(&times[1], iCount - 1, &times[1]);
+    times[iCount] = spline.knots[spline.cpCount];
     
     return times;
 }
 
-vector<float> Parametizer::parametizeSigmoidal(int iCount)
+vector<float> Parametizer::parametizeSigmoidal(int iCount) const
 {
     vector<float> times;
     
-    times.push_back(0.0);
-    float step = 1.0 / float(iCount-1);
-    float x = step;
-    while(iCount--) {
-        float arc = length / (1 + exp(-15.0 * (x - 0.5)));
-        times.push_back(timeForArc(arc));
-        x += step;
+    times.resize(iCount + 1);
+    times[0] = spline.knots[spline.order - 1];
+    double step = 1.0 / double(iCount-1);
+    for(int i = 1; i <= iCount; i++) {
+        double x = step * i;
+        times[i] = float(length / (1 + exp(-15.0 * (x - 0.5))));
     }
+    timesForArcs(&times[1], iCount, &times[1]);
     
     return times;
 }
@@ -11,84 +11,155 @@
 #include <stdio.h>
 #include <vector>
 #include <math.h>
+#include <algorithm>
 
 #include "BSpline.hpp"
 #include "Functor.hpp"
+#include "Hodograph.hpp"
 
 using namespace std;
 
 class Parametizer
 {
     public:
-        Parametizer(BSpline &iSpline)
-        : spline(iSpline), length(0), spanLengths()
+        // Quadrature answers every query with Gauss-Legendre and Newton.
+        // Table samples each span densely enough that monotone cubic
+        // (Fritsch-Carlson) interpolation of s(t) and t(s) stays within
+        // iTolerance arc length, then answers from the table.
+        // Chebyshev fits s(t) and t(s) on each span with Chebyshev series
+        // of adaptive degree and answers with Clenshaw's recurrence.
+        enum Mode
+        {
+            Quadrature,
+            Table,
+            Chebyshev
+        };
+        
+    public:
+        // Speeds come from iHodograph when given and current at init; a
+        // hodograph not updated since the spline last changed is ignored.
+        Parametizer(const BSpline &iSpline, const Hodograph *iHodograph = 0)
+        : spline(iSpline), hodograph(iHodograph), mode(Quadrature), tolerance(0.0), length(0), spanLengths(StdAllocator<double>(iSpline.allocator)), arcPrefix(StdAllocator<double>(iSpline.allocator)),
+          tableStart(StdAllocator<int>(iSpline.allocator)), tableT(StdAllocator<float>(iSpline.allocator)), tableS(StdAllocator<float>(iSpline.allocator)),
+          tableDS(StdAllocator<float>(iSpline.allocator)), tableDT(StdAllocator<float>(iSpline.allocator)),
+          chebStart(StdAllocator<int>(iSpline.allocator)), chebTStart(StdAllocator<int>(iSpline.allocator)),
+          chebS(StdAllocator<float>(iSpline.allocator)), chebT(StdAllocator<float>(iSpline.allocator)), useHodograph(false)
         { }
         
-        void init();
+        void init(Mode iMode = Quadrature, double iTolerance = 1.0e-5);
+        
+        float arcLength(float t) const;
+        float timeForArc(float iArc) const;
+        
+        // ds/dt at t and dt/ds at arc iArc
+        float arcLengthDeriv(float t) const;
+        float timeForArcDeriv(float iArc) const;
         
-        float arcLength(float t);
-        float timeForArc(float iArc);
+        // span holding arc iArc, by binary search of arcPrefix
+        int spanForArc(double iArc) const;
         
-        float segmentArc(int iSeg, float t);
-        float segmentArcDeriv(int iSeg, float t);
+        float segmentArc(int iSeg, float t) const;
+        float segmentArcDeriv(int iSeg, float t) const;
         
-        float timeForSegmentArc(int iSeg, float iArg);
+        float timeForSegmentArc(int iSeg, float iArg) const;
         
-        vector<float> parametizeLinear(int iCount);
-        vector<float> parametizeSigmoidal(int iCount);
+        // timeForArc over nondecreasing arcs in one sweep; oTimes may alias iArcs
+        void timesForArcs(const float *iArcs, int iCount, float *oTimes) const;
+        
+        // table lookups within span iSeg, arcs measured from the span start
+        float tableArc(int iSeg, float t) const;
+        float tableTime(int iSeg, float iArc) const;
+        float chebyshevArc(int iSeg, float t) const;
+        float chebyshevTime(int iSeg, float iArc) const;
+        
+        vector<float> parametizeLinear(int iCount) const;
+        vector<float> parametizeSigmoidal(int iCount) const;
         
     public:
         class MagFunctor: public Functor
         {
             public:
-                MagFunctor(Parametizer &iParametizer) : p(iParametizer) { }
+                MagFunctor(const Parametizer &iParametizer) : p(iParametizer) { }
                 
-                virtual float operator()(float t) { float buff[p.spline.stride]; p.spline.eval(t, buff); float mag = 0.0; int i = p.spline.stride; while(i--) mag += buff[i] * buff[i]; return sqrt(mag); }
+                virtual float operator()(float t) const { float buff[p.spline.stride]; p.spline.eval(t, buff); float mag = 0.0; int i = p.spline.stride; while(i--) mag += buff[i] * buff[i]; return sqrt(mag); }
                 
             protected:
-                Parametizer &p;
+                const Parametizer &p;
         };
         
         class MagDFunctor: public Functor
         {
             public:
-                MagDFunctor(Parametizer &iParametizer) : p(iParametizer) { }
+                MagDFunctor(const Parametizer &iParametizer) : p(iParametizer) { }
                 
-                virtual float operator()(float t) { float buff[p.spline.stride]; p.spline.deriv(t, buff); float mag = 0.0; int i = p.spline.stride; while(i--) mag += buff[i] * buff[i]; return sqrt(mag); }
+                virtual float operator()(float t) const { float buff[p.spline.stride]; if(p.useHodograph) p.hodograph->deriv(t, buff); else p.spline.deriv(t, buff); float mag = 0.0; int i = p.spline.stride; while(i--) mag += buff[i] * buff[i]; return sqrt(mag); }
                 
             protected:
-                Parametizer &p;
+                const Parametizer &p;
         };
         
         class SegArcFunctor: public Functor
         {
             public:
-                SegArcFunctor(Parametizer &iParametizer, int iSeg) : p(iParametizer), seg(iSeg) { }
+                SegArcFunctor(const Parametizer &iParametizer, int iSeg) : p(iParametizer), seg(iSeg) { }
                 
-                virtual float operator()(float t) { return p.segmentArc(seg, t); }
+                virtual float operator()(float t) const { return p.segmentArc(seg, t); }
                 
             protected:
-                Parametizer &p;
+                const Parametizer &p;
                 int seg;
         };
         
         class SegArcDFunctor: public Functor
         {
             public:
-                SegArcDFunctor(Parametizer &iParametizer, int iSeg) : p(iParametizer), seg(iSeg) { }
+                SegArcDFunctor(const Parametizer &iParametizer, int iSeg) : p(iParametizer), seg(iSeg) { }
                 
-                virtual float operator()(float t) { return p.segmentArcDeriv(seg, t); }
+                virtual float operator()(float t) const { return p.segmentArcDeriv(seg, t); }
                 
             protected:
-                Parametizer &p;
+                const Parametizer &p;
                 int seg;
         };
     
     public:
-        BSpline &spline;
+        const BSpline &spline;
+        const Hodograph *hodograph;
+        Mode mode;
+        double tolerance;
         
         double length;
-        vector<double> spanLengths;
+        // drawn from the spline's allocator
+        vector<double, StdAllocator<double> > spanLengths;
+        // arc length at the start of each span, plus length at the end
+        vector<double, StdAllocator<double> > arcPrefix;
+        
+    protected:
+        void buildTable(int iSeg, vector<float> &ioT, vector<float> &ioS, vector<float> &ioDS, vector<float> &ioDT);
+        void fitChebyshev(int iSeg, vector<float> &ioS, vector<float> &ioT);
+        float solveSegment(int iSeg, double iArc, double &ioX, double &ioS) const;
+        
+    protected:
+        // Table mode: span i owns nodes tableStart[i] .. tableStart[i + 1] - 1,
+        // evenly spaced in t, with arc from the span start and Fritsch-Carlson
+        // limited slopes ds/dt and dt/ds.
+        vector<int, StdAllocator<int> > tableStart;
+        vector<float, StdAllocator<float> > tableT;
+        vector<float, StdAllocator<float> > tableS;
+        vector<float, StdAllocator<float> > tableDS;
+        vector<float, StdAllocator<float> > tableDT;
+        
+        // Chebyshev mode: span i's series for s(t) - arcPrefix[i] in
+        // u = 2 (t - t0) / h - 1 is chebS[chebStart[i] .. chebStart[i + 1]),
+        // and for t(s) - t0 in u = 2 s / spanLengths[i] - 1 it is chebT from
+        // chebTStart[i]. Written only by init.
+        vector<int, StdAllocator<int> > chebStart;
+        vector<int, StdAllocator<int> > chebTStart;
+        vector<float, StdAllocator<float> > chebS;
+        vector<float, StdAllocator<float> > chebT;
+        
+        // set by init when hodograph is current for the spline
+        bool useHodograph;
 };
 
 #endif /* Parametizer_hpp */
@@ -0,0 +1,60 @@
+//
+//  Planar.cpp
+//  BSpline
+//
+
+#include "Planar.hpp"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+
+int planarPitch(int iCount)
+{
+    return (iCount + 15) & ~15;
+}
+
+void interleavedToPlanar(const float *iCP, int iStride, int iCount, float *oPlanes, int iPitch)
+{
+    for(int j = 0; j < iCount; j++, iCP += iStride)
+        for(int i = 0; i < iStride; i++)
+            oPlanes[i * iPitch + j] = iCP[i];
+}
+
+void planarToInterleaved(const float *iPlanes, int iPitch, int iStride, int iCount, float *oCP)
+{
+    for(int j = 0; j < iCount; j++, oCP += iStride)
+        for(int i = 0; i < iStride; i++)
+            oCP[i] = iPlanes[i * iPitch + j];
+}
+
+PlanarControlPoints::PlanarControlPoints()
+: data(0), stride(0), count(0), pitch(0), block(0)
+{ }
+
+PlanarControlPoints::PlanarControlPoints(int iStride, int iCount)
+: data(0), stride(0), count(0), pitch(0), block(0)
+{
+    resize(iStride, iCount);
+}
+
+PlanarControlPoints::~PlanarControlPoints()
+{
+    free(block);
+}
+
+void PlanarControlPoints::resize(int iStride, int iCount)
+{
+    free(block);
+    stride = iStride;
+    count = iCount;
+    pitch = planarPitch(iCount);
+
+    block = malloc(size_t(stride) * size_t(pitch) * sizeof(float) + 63);
+    if(!block) {
+        data = 0;
+        stride = count = pitch = 0;
+        throw std::bad_alloc();
+    }
+    data = (float *)((uintptr_t(block) + 63) & ~uintptr_t(63));
+}
@@ -0,0 +1,46 @@
+//
+//  Planar.hpp
+//  BSpline
+//
+
+#ifndef Planar_hpp
+#define Planar_hpp
+
+#include <stdio.h>
+
+// Structure-of-arrays control point layout: dimension i's control points are
+// contiguous at oPlanes + i * iPitch. planarPitch rounds to whole 64-byte lines.
+int planarPitch(int iCount);
+void interleavedToPlanar(const float *iCP, int iStride, int iCount, float *oPlanes, int iPitch);
+void planarToInterleaved(const float *iPlanes, int iPitch, int iStride, int iCount, float *oCP);
+
+// 64-byte aligned planar control point storage.
+class PlanarControlPoints
+{
+    public:
+        PlanarControlPoints();
+        PlanarControlPoints(int iStride, int iCount);
+        ~PlanarControlPoints();
+
+        void resize(int iStride, int iCount);
+
+        void fromInterleaved(const float *iCP) { interleavedToPlanar(iCP, stride, count, data, pitch); }
+        void toInterleaved(float *oCP) const { planarToInterleaved(data, pitch, stride, count, oCP); }
+
+        float *plane(int i) { return data + i * pitch; }
+
+    public:
+        float *data;
+        int stride;
+        int count;
+        int pitch;
+
+    protected:
+        void *block;
+
+    private:
+        PlanarControlPoints(const PlanarControlPoints &);
+        PlanarControlPoints &operator=(const PlanarControlPoints &);
+};
+
+#endif /* Planar_hpp */
@@ -0,0 +1,111 @@
+//
+//  Sampler.cpp
+//  BSpline
+//
+
+#include "Sampler.hpp"
+
+#include <math.h>
+
+Sampler::Sampler(const BSpline &iSpline, float iStep, int iCheckInterval, float iTolerance)
+: spline(iSpline), step(iStep), checkInterval(iCheckInterval), tolerance(iTolerance),
+  reanchorCount(0), maxError(0.0), span(-1), anchor(0.0), steps(0), sinceCheck(0), table(StdAllocator<double>(iSpline.allocator))
+{ }
+
+void Sampler::start(float t0)
+{
+    reanchorCount = 0;
+    maxError = 0.0;
+    span = -1;
+    reanchor(t0);
+}
+
+// Rebuilds the difference table from the span polynomial at t: table row j
+// holds the j-th forward difference of the samples t, t + step, ... computed
+// analytically, in double so the running sums stay accurate across a span.
+void Sampler::reanchor(float t)
+{
+    int order = spline.order;
+    int stride = spline.stride;
+    int p = order - 1;
+
+    span = spline.findSpan(t, span);
+    anchor = t;
+    steps = 0;
+    sinceCheck = 0;
+    reanchorCount++;
+
+    float c[order * stride];
+    spline.spanCoefficients(span, c);
+    double u0 = spline.knots[span];
+    double invH = 1.0 / (double(spline.knots[span + 1]) - u0);
+    double x0 = (double(t) - u0) * invH;
+    double dx = double(step) * invH;
+
+    // Stirling numbers of the second kind: delta^j n^k at n = 0 is j! S(k, j)
+    double S[order * order];
+    for(int k = 0; k < order * order; k++)
+        S[k] = 0.0;
+    S[0] = 1.0;
+    for(int k = 1; k <= p; k++)
+        for(int j = 1; j <= k; j++)
+            S[k * order + j] = double(j) * S[(k - 1) * order + j] + S[(k - 1) * order + j - 1];
+
+    table.resize(order * stride);
+    double a[order];
+    for(int i = 0; i < stride; i++) {
+        // Taylor shift to x0, then rescale so one step is one unit
+        for(int k = 0; k <= p; k++)
+            a[k] = c[k * stride + i];
+        for(int m = 0; m < p; m++)
+            for(int k = p - 1; k >= m; k--)
+                a[k] += x0 * a[k + 1];
+        double scale = 1.0;
+        for(int k = 0; k <= p; k++, scale *= dx)
+            a[k] *= scale;
+
+        double fact = 1.0;
+        for(int j = 0; j <= p; j++) {
+            if(j) fact *= double(j);
+            double d = 0.0;
+            for(int k = j; k <= p; k++)
+                d += a[k] * S[k * order + j];
+            table[j * stride + i] = d * fact;
+        }
+    }
+}
+
+bool Sampler::next(float *oPoint)
+{
+    int stride = spline.stride;
+    int p = spline.order - 1;
+    float t = time();
+    if(t > spline.knots[spline.cpCount]) return false;
+
+    if((span < spline.cpCount - 1) && (t >= spline.knots[span + 1]))
+        reanchor(t);
+
+    if((checkInterval > 0) && (++sinceCheck >= checkInterval)) {
+        sinceCheck = 0;
+        float exact[stride];
+        spline.eval(t, exact);
+        float err = 0.0;
+        for(int i = 0; i < stride; i++)
+            err = fmax(err, fabs(exact[i] - float(table[i])));
+        if(err > maxError) maxError = err;
+        if(err > tolerance) reanchor(t);
+    }
+
+    for(int i = 0; i < stride; i++)
+        oPoint[i] = float(table[i]);
+
+    for(int j = 0; j < p; j++) {
+        double *row = &table[j * stride];
+        const double *next = row + stride;
+        for(int i = 0; i < stride; i++)
+            row[i] += next[i];
+    }
+    steps++;
+
+    return true;
+}
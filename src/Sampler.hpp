@@ -0,0 +1,49 @@
+//
+//  Sampler.hpp
+//  BSpline
+//
+
+#ifndef Sampler_hpp
+#define Sampler_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "BSpline.hpp"
+
+// Streams a BSpline at a constant parameter step by forward differencing the
+// span polynomial: each sample costs order - 1 vector additions. The table is
+// rebuilt at every knot span and, if iCheckInterval > 0, compared against an
+// exact eval every iCheckInterval samples and rebuilt when it drifts past
+// iTolerance.
+class Sampler
+{
+    public:
+        Sampler(const BSpline &iSpline, float iStep, int iCheckInterval = 0, float iTolerance = 1.0e-5);
+
+        void start(float t0);
+        bool next(float *oPoint);
+
+        float time() const { return anchor + float(steps) * step; }
+
+    protected:
+        void reanchor(float t);
+
+    public:
+        const BSpline &spline;
+        float step;
+        int checkInterval;
+        float tolerance;
+
+        int reanchorCount;
+        float maxError;
+
+    protected:
+        int span;
+        float anchor;
+        int steps;
+        int sinceCheck;
+        std::vector<double, StdAllocator<double> > table;
+};
+
+#endif /* Sampler_hpp */
@@ -0,0 +1,333 @@
+//
+//  Simd.cpp
+//  BSpline
+//
+
+#include "Simd.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BSPLINE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static void weightedSumScalar(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    for(int i = 0; i < n; i++)
+        oOut[i] = 0.0;
+    for(int j = 0; j < iCount; j++, iRows += iRowStride) {
+        float b = iWeights[j];
+        for(int i = 0; i < n; i++)
+            oOut[i] += iRows[i] * b;
+    }
+}
+
+static void hornerSumScalar(const float *iCoeffs, int iRowStride, int iDegree, const float *iXs, int iCount, int n, float *oOut, int iOutStride)
+{
+    const float *top = iCoeffs + iDegree * iRowStride;
+    for(int m = 0; m < iCount; m++, oOut += iOutStride) {
+        float x = iXs[m];
+        for(int i = 0; i < n; i++) {
+            float acc = top[i];
+            for(int k = iDegree - 1; k >= 0; k--)
+                acc = acc * x + iCoeffs[k * iRowStride + i];
+            oOut[i] = acc;
+        }
+    }
+}
+
+static void rowDotsScalar(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    for(int i = 0; i < n; i++, iRows += iRowStride) {
+        float acc = 0.0;
+        for(int j = 0; j < iCount; j++)
+            acc += iRows[j] * iWeights[j];
+        oOut[i] = acc;
+    }
+}
+
+#ifdef BSPLINE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void weightedSumSSE(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 acc = _mm_setzero_ps();
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(row), _mm_set1_ps(iWeights[j])));
+        _mm_storeu_ps(oOut + i, acc);
+    }
+    for(; i < n; i++) {
+        float acc = 0.0;
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc += *row * iWeights[j];
+        oOut[i] = acc;
+    }
+}
+
+static const int tailMask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+__attribute__((target("avx2,fma")))
+static void weightedSumAVX2(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    int i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(row), _mm256_set1_ps(iWeights[j]), acc);
+        _mm256_storeu_ps(oOut + i, acc);
+    }
+    if(i < n) {
+        __m256i mask = _mm256_loadu_si256((const __m256i *)(tailMask + 8 - (n - i)));
+        __m256 acc = _mm256_setzero_ps();
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc = _mm256_fmadd_ps(_mm256_maskload_ps(row, mask), _mm256_set1_ps(iWeights[j]), acc);
+        _mm256_maskstore_ps(oOut + i, mask, acc);
+    }
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static void weightedSumAVX512(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    int i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m512 acc = _mm512_setzero_ps();
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(row), _mm512_set1_ps(iWeights[j]), acc);
+        _mm512_storeu_ps(oOut + i, acc);
+    }
+    if((i < n) && (n - i <= 8)) {
+        // short tails such as stride 3 or 7 are cheaper in one ymm register
+        __m256i mask = _mm256_loadu_si256((const __m256i *)(tailMask + 8 - (n - i)));
+        __m256 acc = _mm256_setzero_ps();
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc = _mm256_fmadd_ps(_mm256_maskload_ps(row, mask), _mm256_set1_ps(iWeights[j]), acc);
+        _mm256_maskstore_ps(oOut + i, mask, acc);
+    } else if(i < n) {
+        __mmask16 mask = __mmask16((1u << (n - i)) - 1u);
+        __m512 acc = _mm512_setzero_ps();
+        const float *row = iRows + i;
+        for(int j = 0; j < iCount; j++, row += iRowStride)
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, row), _mm512_set1_ps(iWeights[j]), acc);
+        _mm512_mask_storeu_ps(oOut + i, mask, acc);
+    }
+}
+
+__attribute__((target("sse2")))
+static void hornerSumSSE(const float *iCoeffs, int iRowStride, int iDegree, const float *iXs, int iCount, int n, float *oOut, int iOutStride)
+{
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const float *c = iCoeffs + i;
+        __m128 top = _mm_loadu_ps(c + iDegree * iRowStride);
+        float *out = oOut + i;
+        for(int m = 0; m < iCount; m++, out += iOutStride) {
+            __m128 x = _mm_set1_ps(iXs[m]);
+            __m128 acc = top;
+            for(int k = iDegree - 1; k >= 0; k--)
+                acc = _mm_add_ps(_mm_mul_ps(acc, x), _mm_loadu_ps(c + k * iRowStride));
+            _mm_storeu_ps(out, acc);
+        }
+    }
+    if(i < n)
+        hornerSumScalar(iCoeffs + i, iRowStride, iDegree, iXs, iCount, n - i, oOut + i, iOutStride);
+}
+
+__attribute__((target("avx2,fma")))
+static void hornerSumAVX2(const float *iCoeffs, int iRowStride, int iDegree, const float *iXs, int iCount, int n, float *oOut, int iOutStride)
+{
+    for(int i = 0; i < n; i += 8) {
+        const float *c = iCoeffs + i;
+        float *out = oOut + i;
+        if(i + 8 <= n) {
+            __m256 top = _mm256_loadu_ps(c + iDegree * iRowStride);
+            for(int m = 0; m < iCount; m++, out += iOutStride) {
+                __m256 x = _mm256_set1_ps(iXs[m]);
+                __m256 acc = top;
+                for(int k = iDegree - 1; k >= 0; k--)
+                    acc = _mm256_fmadd_ps(acc, x, _mm256_loadu_ps(c + k * iRowStride));
+                _mm256_storeu_ps(out, acc);
+            }
+        } else {
+            __m256i mask = _mm256_loadu_si256((const __m256i *)(tailMask + 8 - (n - i)));
+            __m256 top = _mm256_maskload_ps(c + iDegree * iRowStride, mask);
+            for(int m = 0; m < iCount; m++, out += iOutStride) {
+                __m256 x = _mm256_set1_ps(iXs[m]);
+                __m256 acc = top;
+                for(int k = iDegree - 1; k >= 0; k--)
+                    acc = _mm256_fmadd_ps(acc, x, _mm256_maskload_ps(c + k * iRowStride, mask));
+                _mm256_maskstore_ps(out, mask, acc);
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static void hornerSumAVX512(const float *iCoeffs, int iRowStride, int iDegree, const float *iXs, int iCount, int n, float *oOut, int iOutStride)
+{
+    int i = 0;
+    for(; i + 16 <= n; i += 16) {
+        const float *c = iCoeffs + i;
+        __m512 top = _mm512_loadu_ps(c + iDegree * iRowStride);
+        float *out = oOut + i;
+        for(int m = 0; m < iCount; m++, out += iOutStride) {
+            __m512 x = _mm512_set1_ps(iXs[m]);
+            __m512 acc = top;
+            for(int k = iDegree - 1; k >= 0; k--)
+                acc = _mm512_fmadd_ps(acc, x, _mm512_loadu_ps(c + k * iRowStride));
+            _mm512_storeu_ps(out, acc);
+        }
+    }
+    if(i < n) {
+        // as in weightedSumAVX512, short tails go through the ymm kernel
+        if(n - i <= 8) {
+            hornerSumAVX2(iCoeffs + i, iRowStride, iDegree, iXs, iCount, n - i, oOut + i, iOutStride);
+            return;
+        }
+        __mmask16 mask = __mmask16((1u << (n - i)) - 1u);
+        const float *c = iCoeffs + i;
+        __m512 top = _mm512_maskz_loadu_ps(mask, c + iDegree * iRowStride);
+        float *out = oOut + i;
+        for(int m = 0; m < iCount; m++, out += iOutStride) {
+            __m512 x = _mm512_set1_ps(iXs[m]);
+            __m512 acc = top;
+            for(int k = iDegree - 1; k >= 0; k--)
+                acc = _mm512_fmadd_ps(acc, x, _mm512_maskz_loadu_ps(mask, c + k * iRowStride));
+            _mm512_mask_storeu_ps(out, mask, acc);
+        }
+    }
+}
+
+// Four rows at a time, each accumulated in its own register along j, then
+// reduced together with two rounds of horizontal adds.
+__attribute__((target("sse3")))
+static void rowDotsSSE(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    int whole = iCount & ~3;
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const float *r0 = iRows + i * iRowStride;
+        const float *r1 = r0 + iRowStride;
+        const float *r2 = r1 + iRowStride;
+        const float *r3 = r2 + iRowStride;
+        __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+        for(int j = 0; j < whole; j += 4) {
+            __m128 w = _mm_loadu_ps(iWeights + j);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(r0 + j), w));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(r1 + j), w));
+            a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(r2 + j), w));
+            a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_loadu_ps(r3 + j), w));
+        }
+        __m128 acc = _mm_hadd_ps(_mm_hadd_ps(a0, a1), _mm_hadd_ps(a2, a3));
+        for(int j = whole; j < iCount; j++) {
+            __m128 w = _mm_set1_ps(iWeights[j]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_setr_ps(r0[j], r1[j], r2[j], r3[j]), w));
+        }
+        _mm_storeu_ps(oOut + i, acc);
+    }
+    for(; i < n; i++) {
+        const float *r = iRows + i * iRowStride;
+        __m128 a = _mm_setzero_ps();
+        for(int j = 0; j < whole; j += 4)
+            a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(r + j), _mm_loadu_ps(iWeights + j)));
+        a = _mm_hadd_ps(a, a);
+        float acc = _mm_cvtss_f32(_mm_hadd_ps(a, a));
+        for(int j = whole; j < iCount; j++)
+            acc += r[j] * iWeights[j];
+        oOut[i] = acc;
+    }
+}
+
+#endif
+
+static WeightedSumFn selectWeightedSum(const char **oName)
+{
+#ifdef BSPLINE_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *oName = "avx512";
+        return weightedSumAVX512;
+    }
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *oName = "avx2";
+        return weightedSumAVX2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        *oName = "sse";
+        return weightedSumSSE;
+    }
+#endif
+    *oName = "scalar";
+    return weightedSumScalar;
+}
+
+static HornerSumFn selectHornerSum()
+{
+#ifdef BSPLINE_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return hornerSumAVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return hornerSumAVX2;
+    if(__builtin_cpu_supports("sse2"))
+        return hornerSumSSE;
+#endif
+    return hornerSumScalar;
+}
+
+static RowDotsFn selectRowDots()
+{
+#ifdef BSPLINE_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse3"))
+        return rowDotsSSE;
+#endif
+    return rowDotsScalar;
+}
+
+static const char *kernelName = "scalar";
+
+WeightedSumFn weightedSumKernel()
+{
+    static const WeightedSumFn fn = selectWeightedSum(&kernelName);
+    return fn;
+}
+
+void weightedSum(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    weightedSumKernel()(iRows, iRowStride, iWeights, iCount, n, oOut);
+}
+
+HornerSumFn hornerSumKernel()
+{
+    static const HornerSumFn fn = selectHornerSum();
+    return fn;
+}
+
+void hornerSum(const float *iCoeffs, int iRowStride, int iDegree, const float *iXs, int iCount, int n, float *oOut, int iOutStride)
+{
+    hornerSumKernel()(iCoeffs, iRowStride, iDegree, iXs, iCount, n, oOut, iOutStride);
+}
+
+RowDotsFn rowDotsKernel()
+{
+    static const RowDotsFn fn = selectRowDots();
+    return fn;
+}
+
+void rowDots(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut)
+{
+    rowDotsKernel()(iRows, iRowStride, iWeights, iCount, n, oOut);
+}
+
+const char *simdKernelName()
+{
+    weightedSumKernel();
+    return kernelName;
+}
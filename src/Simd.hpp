@@ -0,0 +1,36 @@
+//
+//  Simd.hpp
+//  BSpline
+//
+
+#ifndef Simd_hpp
+#define Simd_hpp
+
+#include <stdio.h>
+
+// oOut[i] = sum over j < iCount of iWeights[j] * iRows[j * iRowStride + i], for i < n.
+// Dispatches at runtime to AVX-512, AVX2/FMA or SSE kernels on x86, scalar elsewhere.
+void weightedSum(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut);
+
+// The kernel weightedSum dispatches to, for hoisting out of hot loops.
+typedef void (*WeightedSumFn)(const float *, int, const float *, int, int, float *);
+WeightedSumFn weightedSumKernel();
+
+// oOut[m * iOutStride + i] = sum over k <= iDegree of iCoeffs[k * iRowStride + i] * iXs[m]^k,
+// for m < iCount and i < n: one polynomial per dimension, evaluated by Horner
+// at iCount points. The coefficient rows are loaded once for all points.
+void hornerSum(const float *iCoeffs, int iRowStride, int iDegree, const float *iXs, int iCount, int n, float *oOut, int iOutStride);
+
+typedef void (*HornerSumFn)(const float *, int, int, const float *, int, int, float *, int);
+HornerSumFn hornerSumKernel();
+
+// oOut[i] = sum over j < iCount of iWeights[j] * iRows[i * iRowStride + j], for i < n:
+// short dot products along rows, such as one per plane of planar control points.
+void rowDots(const float *iRows, int iRowStride, const float *iWeights, int iCount, int n, float *oOut);
+
+typedef void (*RowDotsFn)(const float *, int, const float *, int, int, float *);
+RowDotsFn rowDotsKernel();
+
+const char *simdKernelName();
+
+#endif /* Simd_hpp */
@@ -0,0 +1,179 @@
+//
+//  SpanPacked.cpp
+//  BSpline
+//
+
+#include "SpanPacked.hpp"
+#include "Simd.hpp"
+#include "KnotSpan.hpp"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+
+SpanPackedBSpline::SpanPackedBSpline(const BSpline &iSpline)
+: order(iSpline.order), stride(iSpline.stride), spanCount(0), blockSize(0),
+  uniform(iSpline.knotClass != BSpline::GeneralKnots), invSpacing(0.0), breaks(), buckets(), invBucketWidth(0.0), blocks(0), storage(0)
+{
+    int p = order - 1;
+    blockSize = (2 * p + order * stride + 15) & ~15;
+    if(uniform) invSpacing = 1.0 / iSpline.knotSpacing;
+
+    for(int s = p; s < iSpline.cpCount; s++)
+        if(iSpline.knots[s + 1] > iSpline.knots[s])
+            spanCount++;
+
+    storage = malloc(size_t(spanCount) * size_t(blockSize) * sizeof(float) + 63);
+    if(!storage) throw std::bad_alloc();
+    blocks = (float *)((uintptr_t(storage) + 63) & ~uintptr_t(63));
+
+    float scratch[order * stride];
+    float *b = blocks;
+    for(int s = p; s < iSpline.cpCount; s++) {
+        if(iSpline.knots[s + 1] <= iSpline.knots[s]) continue;
+
+        for(int m = 0; m < 2 * p; m++)
+            b[m] = iSpline.knots[s - p + 1 + m];
+        const float *cp = iSpline.spanPoints(s, scratch);
+        for(int i = 0; i < order * stride; i++)
+            b[2 * p + i] = cp[i];
+        for(int i = 2 * p + order * stride; i < blockSize; i++)
+            b[i] = 0.0;
+
+        breaks.push_back(iSpline.knots[s]);
+        b += blockSize;
+    }
+    breaks.push_back(iSpline.knots[iSpline.cpCount]);
+
+    // bucket index so random lookups on general knots search a few breaks
+    // instead of the whole array
+    if(!uniform && spanCount) {
+        invBucketWidth = float(spanCount) / (breaks[spanCount] - breaks[0]);
+        buckets.resize(spanCount + 1);
+        int span = 0;
+        for(int i = 0; i <= spanCount; i++) {
+            float t = breaks[0] + float(i) / invBucketWidth;
+            while((span < spanCount - 1) && (breaks[span + 1] <= t))
+                span++;
+            buckets[i] = span;
+        }
+    }
+}
+
+SpanPackedBSpline::~SpanPackedBSpline()
+{
+    free(storage);
+}
+
+int SpanPackedBSpline::findSpan(float t, int iHint) const
+{
+    const float *b = &breaks[0];
+    int lo = 0;
+    int hi = spanCount - 1;
+    int span;
+    if(spanAtEnds(b, 1, lo, hi, t, span)) return span;
+    if(uniform) return latticeSpan(b, 1, lo, hi, t, invSpacing);
+    span = hintedSpan(b, 1, lo, hi, t, iHint);
+    if(span >= 0) return span;
+
+    int bucket = int((t - b[0]) * invBucketWidth);
+    if(bucket >= spanCount) bucket = spanCount - 1;
+    lo = buckets[bucket];
+    if(buckets[bucket + 1] < hi) hi = buckets[bucket + 1];
+    // guard against rounding at bucket edges
+    while((lo > 0) && (b[lo] > t)) lo--;
+    while((hi < spanCount - 1) && (b[hi + 1] <= t)) hi++;
+    return searchSpan(b, 1, lo, hi, t);
+}
+
+float SpanPackedBSpline::clamp(float t) const
+{
+    if(t < breaks[0]) return breaks[0];
+    if(t > breaks[spanCount]) return breaks[spanCount];
+    return t;
+}
+
+void SpanPackedBSpline::prefetch(int iSpan) const
+{
+#if defined(__GNUC__) || defined(__clang__)
+    if(iSpan >= spanCount) return;
+    const char *b = (const char *)block(iSpan);
+    for(int offset = 0; offset < blockSize * int(sizeof(float)); offset += 64)
+        __builtin_prefetch(b + offset);
+#endif
+}
+
+// NURBS Book A2.2 on knots around a span, iSpanKnots[0] being the span's
+// first knot; reads iSpanKnots[1 - iDegree] .. iSpanKnots[iDegree].
+void SpanPackedBSpline::basisFuns(const float *iSpanKnots, float t, int iDegree, float *oN)
+{
+    float left[iDegree + 1];
+    float right[iDegree + 1];
+    oN[0] = 1.0;
+    for(int j = 1; j <= iDegree; j++) {
+        left[j] = t - iSpanKnots[1 - j];
+        right[j] = iSpanKnots[j] - t;
+        float saved = 0.0;
+        for(int r = 0; r < j; r++) {
+            float temp = oN[r] / (right[r + 1] + left[j - r]);
+            oN[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        oN[j] = saved;
+    }
+}
+
+// The block's knots k[m] are the spline's knots span - order + 2 + m, so
+// the span's own first knot is k[p - 1].
+void SpanPackedBSpline::evalSpan(int iSpan, float t, float *oPoint) const
+{
+    int p = order - 1;
+    const float *k = block(iSpan);
+
+    float n[order];
+    basisFuns(k + p - 1, t, p, n);
+    weightedSum(k + 2 * p, stride, n, order, stride, oPoint);
+}
+
+void SpanPackedBSpline::eval(float t, float *oPoint) const
+{
+    t = clamp(t);
+    evalSpan(findSpan(t), t, oPoint);
+}
+
+void SpanPackedBSpline::deriv(float t, float *oPoint) const
+{
+    t = clamp(t);
+    int span = findSpan(t);
+    int p = order - 1;
+    const float *k = block(span);
+
+    // degree p - 1 basis, then fold the control point differences into weights
+    float n[order];
+    basisFuns(k + p - 1, t, p - 1, n);
+
+    float w[order];
+    for(int j = 0; j <= p; j++)
+        w[j] = 0.0;
+    for(int j = 0; j < p; j++) {
+        float fn = float(p) / (k[p + j] - k[j]) * n[j];
+        w[j] -= fn;
+        w[j + 1] += fn;
+    }
+
+    weightedSum(k + 2 * p, stride, w, order, stride, oPoint);
+}
+
+void SpanPackedBSpline::evalBatch(const float *ts, int n, float *out) const
+{
+    int span = -1;
+    for(int m = 0; m < n; m++, out += stride) {
+        float t = clamp(ts[m]);
+        int s = findSpan(t, span);
+        if(s != span) {
+            span = s;
+            prefetch(span + 1);
+        }
+        evalSpan(span, t, out);
+    }
+}
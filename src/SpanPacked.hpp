@@ -0,0 +1,60 @@
+//
+//  SpanPacked.hpp
+//  BSpline
+//
+
+#ifndef SpanPacked_hpp
+#define SpanPacked_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "BSpline.hpp"
+
+// Span-blocked copy of a BSpline for very long trajectories. Each non-empty
+// knot span gets one 64-byte aligned block holding the 2 * (order - 1) knots
+// its basis depends on followed by its order control points, so an
+// evaluation reads one contiguous block instead of scattered knots and
+// control points. Sorted sweeps prefetch the next block.
+class SpanPackedBSpline
+{
+    public:
+        SpanPackedBSpline(const BSpline &iSpline);
+        ~SpanPackedBSpline();
+
+        int findSpan(float t, int iHint = -1) const;
+        const float *block(int iSpan) const { return blocks + iSpan * blockSize; }
+
+        void eval(float t, float *oPoint) const;
+        void deriv(float t, float *oPoint) const;
+        void evalBatch(const float *ts, int n, float *out) const;
+
+    protected:
+        float clamp(float t) const;
+        static void basisFuns(const float *iSpanKnots, float t, int iDegree, float *oN);
+        void evalSpan(int iSpan, float t, float *oPoint) const;
+        void prefetch(int iSpan) const;
+
+    public:
+        int order;
+        int stride;
+        int spanCount;
+        // floats per block, a multiple of 16
+        int blockSize;
+
+    protected:
+        bool uniform;
+        float invSpacing;
+        std::vector<float> breaks;
+        // first span of each of spanCount equal-width buckets over the domain
+        std::vector<int> buckets;
+        float invBucketWidth;
+        float *blocks;
+        void *storage;
+
+    private:
+        SpanPackedBSpline(const SpanPackedBSpline &);
+        SpanPackedBSpline &operator=(const SpanPackedBSpline &);
+};
+
+#endif /* SpanPacked_hpp */
@@ -0,0 +1,239 @@
+//
+//  SplineBank.cpp
+//  BSpline
+//
+
+#include "SplineBank.hpp"
+#include "Planar.hpp"
+#include "Simd.hpp"
+#include "KnotSpan.hpp"
+
+#include <new>
+
+// lanes per block of the per-lane path
+static const int laneBlock = 16;
+
+SplineBank::SplineBank(int iOrder, int iStride, int iCPCount, int iCapacity, Allocator *iAllocator)
+: order(iOrder), stride(iStride), cpCount(iCPCount), capacity(iCapacity), pitch(planarPitch(iCapacity)), count(0), sharedKnots(true),
+  cps(0), knots(0), allocator(iAllocator ? iAllocator : &heapAllocator()),
+  shapeKnots(iCPCount + iOrder, 0.0f, StdAllocator<float>(allocator)),
+  shape(0, &shapeKnots[0], iCPCount, iOrder, allocator)
+{
+    size_t cpSize = size_t(cpCount) * size_t(stride) * size_t(pitch);
+    size_t knotSize = size_t(cpCount + order) * size_t(pitch);
+    cps = (float *)allocator->allocate(cpSize * sizeof(float), 64);
+    knots = cps ? (float *)allocator->allocate(knotSize * sizeof(float), 64) : 0;
+    if(!knots) {
+        allocator->deallocate(cps, cpSize * sizeof(float));
+        throw std::bad_alloc();
+    }
+
+    // unused lanes hold zero control points on clamped uniform knots, so
+    // whole rows and whole lane blocks can be evaluated without checks
+    for(size_t i = 0; i < cpSize; i++)
+        cps[i] = 0.0;
+    for(int k = 0; k < cpCount + order; k++) {
+        float u = (k < order) ? 0.0f : ((k < cpCount) ? float(k - order + 1) : float(cpCount - order + 1));
+        for(int l = 0; l < pitch; l++)
+            knots[k * pitch + l] = u;
+    }
+}
+
+SplineBank::~SplineBank()
+{
+    allocator->deallocate(cps, size_t(cpCount) * size_t(stride) * size_t(pitch) * sizeof(float));
+    allocator->deallocate(knots, size_t(cpCount + order) * size_t(pitch) * sizeof(float));
+}
+
+bool SplineBank::matches(const BSpline &iSpline) const
+{
+    return (iSpline.order == order) && (iSpline.stride == stride) && (iSpline.cpCount == cpCount);
+}
+
+void SplineBank::store(int iLane, const BSpline &iSpline)
+{
+    for(int i = 0; i < cpCount; i++) {
+        for(int d = 0; d < stride; d++) {
+            float v = iSpline.planes ? iSpline.planes[d * iSpline.planePitch + i] : iSpline.cpBuffer[i * stride + d];
+            cps[(i * stride + d) * pitch + iLane] = v;
+        }
+    }
+
+    int knotCount = cpCount + order;
+    for(int k = 0; k < knotCount; k++)
+        knots[k * pitch + iLane] = iSpline.knots[k];
+
+    if(iLane == 0) {
+        shape.init(stride, cpCount, iSpline.knots);
+        sharedKnots = true;
+        for(int l = 1; (l < count) && sharedKnots; l++)
+            for(int k = 0; k < knotCount; k++)
+                if(knots[k * pitch + l] != shapeKnots[k]) { sharedKnots = false; break; }
+    } else if(sharedKnots) {
+        for(int k = 0; k < knotCount; k++)
+            if(iSpline.knots[k] != shapeKnots[k]) { sharedKnots = false; break; }
+    }
+}
+
+int SplineBank::add(const BSpline &iSpline)
+{
+    if((count >= capacity) || !matches(iSpline)) return -1;
+    int lane = count++;
+    store(lane, iSpline);
+    return lane;
+}
+
+bool SplineBank::set(int iLane, const BSpline &iSpline)
+{
+    if((iLane < 0) || (iLane >= count) || !matches(iSpline)) return false;
+    store(iLane, iSpline);
+    // a lane that diverged may have been replaced; recheck from lane 0
+    if(!sharedKnots && (iLane != 0)) {
+        sharedKnots = true;
+        int knotCount = cpCount + order;
+        for(int l = 1; (l < count) && sharedKnots; l++)
+            for(int k = 0; k < knotCount; k++)
+                if(knots[k * pitch + l] != shapeKnots[k]) { sharedKnots = false; break; }
+    }
+    return true;
+}
+
+// NURBS Book A2.1 on lane iLane's strided knots
+int SplineBank::laneSpan(int iLane, float t) const
+{
+    return findKnotSpan(knots + iLane, pitch, order - 1, cpCount - 1, t);
+}
+
+void SplineBank::eval(float t, float *oOut) const
+{
+    if(!count) return;
+    if(!sharedKnots) {
+        float ts[count];
+        for(int l = 0; l < count; l++)
+            ts[l] = t;
+        laneQuery(ts, false, oOut);
+        return;
+    }
+
+    t = shape.clamp(t);
+    int span = shape.findSpan(t);
+    float w[order];
+    shape.evalWeights(span, t, w);
+    int rowStride = stride * pitch;
+    weightedSum(cps + (span - order + 1) * rowStride, rowStride, w, order, rowStride, oOut);
+}
+
+void SplineBank::deriv(float t, float *oOut) const
+{
+    if(!count) return;
+    if(!sharedKnots) {
+        float ts[count];
+        for(int l = 0; l < count; l++)
+            ts[l] = t;
+        laneQuery(ts, true, oOut);
+        return;
+    }
+
+    t = shape.clamp(t);
+    int span = shape.findSpan(t);
+    float w[order];
+    shape.derivWeights(span, t, w);
+    int rowStride = stride * pitch;
+    weightedSum(cps + (span - order + 1) * rowStride, rowStride, w, order, rowStride, oOut);
+}
+
+void SplineBank::eval(const float *iTs, float *oOut) const
+{
+    if(count) laneQuery(iTs, false, oOut);
+}
+
+void SplineBank::deriv(const float *iTs, float *oOut) const
+{
+    if(count) laneQuery(iTs, true, oOut);
+}
+
+// NURBS Book A2.2 with every temporary widened to laneBlock lanes. Only the
+// span search and the knot and control point loads are per lane; the
+// recurrence and the accumulation are straight loops over lanes.
+void SplineBank::laneQuery(const float *iTs, bool iDeriv, float *oOut) const
+{
+    int p = order - 1;
+    int degree = iDeriv ? p - 1 : p;
+
+    // blocks always run laneBlock lanes so the loops have a fixed trip count;
+    // lanes past count read the placeholder knots set up in the constructor
+    for(int base = 0; base < count; base += laneBlock) {
+        int n = (count - base < laneBlock) ? count - base : laneBlock;
+
+        // per-lane offsets of knot span and control point span - p
+        float t[laneBlock];
+        int knot[laneBlock];
+        int row[laneBlock];
+        for(int l = 0; l < laneBlock; l++) {
+            int lane = base + l;
+            float lo = knots[p * pitch + lane];
+            float hi = knots[cpCount * pitch + lane];
+            float v = (l < n) ? iTs[lane] : lo;
+            t[l] = (v < lo) ? lo : ((v > hi) ? hi : v);
+            int span = sharedKnots ? shape.findSpan(t[l]) : laneSpan(lane, t[l]);
+            knot[l] = span * pitch + lane;
+            row[l] = (span - p) * stride * pitch + lane;
+        }
+
+        float bn[order][laneBlock];
+        float left[order][laneBlock];
+        float right[order][laneBlock];
+        float saved[laneBlock];
+        for(int l = 0; l < laneBlock; l++)
+            bn[0][l] = 1.0;
+        for(int j = 1; j <= degree; j++) {
+            for(int l = 0; l < laneBlock; l++) {
+                left[j][l] = t[l] - knots[knot[l] + (1 - j) * pitch];
+                right[j][l] = knots[knot[l] + j * pitch] - t[l];
+                saved[l] = 0.0;
+            }
+            for(int r = 0; r < j; r++) {
+                for(int l = 0; l < laneBlock; l++) {
+                    float temp = bn[r][l] / (right[r + 1][l] + left[j - r][l]);
+                    bn[r][l] = saved[l] + right[r + 1][l] * temp;
+                    saved[l] = left[j - r][l] * temp;
+                }
+            }
+            for(int l = 0; l < laneBlock; l++)
+                bn[j][l] = saved[l];
+        }
+
+        // control point weights; the derivative folds p / (u[i+p+1] - u[i+1])
+        // into the degree p - 1 basis as BSpline::derivWeights does
+        float w[order][laneBlock];
+        if(iDeriv) {
+            for(int l = 0; l < laneBlock; l++)
+                w[0][l] = 0.0;
+            for(int j = 0; j < p; j++) {
+                for(int l = 0; l < laneBlock; l++) {
+                    float h = knots[knot[l] + (j + 1) * pitch] - knots[knot[l] + (j + 1 - p) * pitch];
+                    float fn = (h > 0.0f) ? float(p) / h * bn[j][l] : 0.0f;
+                    w[j][l] -= fn;
+                    w[j + 1][l] = fn;
+                }
+            }
+        } else {
+            for(int j = 0; j < order; j++)
+                for(int l = 0; l < laneBlock; l++)
+                    w[j][l] = bn[j][l];
+        }
+
+        for(int d = 0; d < stride; d++) {
+            float acc[laneBlock];
+            for(int l = 0; l < laneBlock; l++)
+                acc[l] = 0.0;
+            for(int j = 0; j < order; j++) {
+                const float *cp = cps + (j * stride + d) * pitch;
+                for(int l = 0; l < laneBlock; l++)
+                    acc[l] += w[j][l] * cp[row[l]];
+            }
+            for(int l = 0; l < laneBlock; l++)
+                oOut[d * pitch + base + l] = acc[l];
+        }
+    }
+}
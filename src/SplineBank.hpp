@@ -0,0 +1,74 @@
+//
+//  SplineBank.hpp
+//  BSpline
+//
+
+#ifndef SplineBank_hpp
+#define SplineBank_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "BSpline.hpp"
+#include "Allocator.hpp"
+
+// Many splines of the same order, stride and control point count, stored
+// across splines: control point i, dimension d of lane l is at
+// cps[(i * stride + d) * pitch + l] and knot k at knots[k * pitch + l].
+// Queries write structure-of-arrays output, oOut[d * pitch + l], so every
+// inner loop runs over contiguous lanes.
+//
+// While all lanes share one knot vector a common t hits the same span in
+// every lane and a query is a single weightedSum over order rows of
+// stride * pitch floats. Otherwise each lane finds its own span and the
+// basis recurrence runs lane-parallel in blocks.
+class SplineBank
+{
+    public:
+        SplineBank(int iOrder, int iStride, int iCPCount, int iCapacity, Allocator *iAllocator = 0);
+        ~SplineBank();
+
+        // Copies iSpline into the next free lane. Returns the lane, or -1 if
+        // the bank is full or iSpline has a different shape.
+        int add(const BSpline &iSpline);
+        bool set(int iLane, const BSpline &iSpline);
+        void clear() { count = 0; sharedKnots = true; }
+
+        void eval(float t, float *oOut) const;
+        void deriv(float t, float *oOut) const;
+
+        // per-lane parameters, iTs[l] for lane l
+        void eval(const float *iTs, float *oOut) const;
+        void deriv(const float *iTs, float *oOut) const;
+
+    protected:
+        bool matches(const BSpline &iSpline) const;
+        void store(int iLane, const BSpline &iSpline);
+        int laneSpan(int iLane, float t) const;
+        void laneQuery(const float *iTs, bool iDeriv, float *oOut) const;
+
+    public:
+        int order;
+        int stride;
+        int cpCount;
+        int capacity;
+        int pitch;
+        int count;
+        // true while every lane holds the same knot vector
+        bool sharedKnots;
+
+        float *cps;
+        float *knots;
+
+    protected:
+        Allocator *allocator;
+        // lane 0's knots, contiguous, for the shared path
+        std::vector<float, StdAllocator<float> > shapeKnots;
+        BSpline shape;
+
+    private:
+        SplineBank(const SplineBank &);
+        SplineBank &operator=(const SplineBank &);
+};
+
+#endif /* SplineBank_hpp */
@@ -0,0 +1,151 @@
+//
+//  stress.cpp
+//  BSpline
+//
+// Many threads query one shared spline, its Hodograph and Parametizers in
+// every mode, and each must reproduce the single-threaded results exactly.
+// Build with -DBSPLINE_TSAN=ON to run it under ThreadSanitizer.
+//
+#include <BSplineCPPConfig.h>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "OwningBSpline.hpp"
+#include "Hodograph.hpp"
+#include "Parametizer.hpp"
+
+using namespace std;
+
+static const int threadCount = 8;
+static const int queryCount = 400;
+static const int passes = 3;
+
+struct Shared
+{
+    const BSpline &spline;
+    const Hodograph &hodograph;
+    const Parametizer &quadrature;
+    const Parametizer &table;
+    const Parametizer &chebyshev;
+};
+
+// Every read-only query, at parameter and arc fractions set by i.
+static void query(const Shared &iShared, int i, vector<float> &oResults)
+{
+    const BSpline &spline = iShared.spline;
+    int stride = spline.stride;
+    float t0 = spline.knots[spline.order - 1];
+    float t1 = spline.knots[spline.cpCount];
+    float f = float(i) / float(queryCount - 1);
+    float t = t0 + (t1 - t0) * f;
+
+    float point[3 * stride];
+    spline.eval(t, point);
+    oResults.insert(oResults.end(), point, point + stride);
+    spline.deriv(t, point);
+    oResults.insert(oResults.end(), point, point + stride);
+    spline.evalDerivs(t, 2, point);
+    oResults.insert(oResults.end(), point, point + 3 * stride);
+    iShared.hodograph.deriv(2, t, point);
+    oResults.insert(oResults.end(), point, point + stride);
+
+    float ts[4] = { t0, t, (t + t1) * 0.5f, t1 };
+    float batch[4 * stride];
+    spline.evalBatch(ts, 4, batch);
+    oResults.insert(oResults.end(), batch, batch + 4 * stride);
+    spline.derivBatch(ts, 4, batch);
+    oResults.insert(oResults.end(), batch, batch + 4 * stride);
+
+    const Parametizer *params[3] = { &iShared.quadrature, &iShared.table, &iShared.chebyshev };
+    for(int m = 0; m < 3; m++) {
+        const Parametizer &param = *params[m];
+        float arc = param.length * f;
+        oResults.push_back(param.arcLength(t));
+        oResults.push_back(param.arcLengthDeriv(t));
+        oResults.push_back(param.timeForArc(arc));
+        oResults.push_back(param.timeForArcDeriv(arc));
+
+        float arcs[3] = { arc * 0.25f, arc * 0.5f, arc };
+        param.timesForArcs(arcs, 3, arcs);
+        oResults.insert(oResults.end(), arcs, arcs + 3);
+    }
+
+    if(i % 50 == 0) {
+        vector<float> times = iShared.table.parametizeSigmoidal(16);
+        oResults.insert(oResults.end(), times.begin(), times.end());
+    }
+}
+
+// Runs the queries starting at a per-thread offset, so threads hit
+// different spans at the same time, and files the results by query.
+static void worker(const Shared &iShared, int iOffset, vector<vector<float> > &oResults)
+{
+    for(int pass = 0; pass < passes; pass++) {
+        for(int n = 0; n < queryCount; n++) {
+            int i = (n + iOffset) % queryCount;
+            oResults[i].clear();
+            query(iShared, i, oResults[i]);
+        }
+    }
+}
+
+int main(int argc, const char * argv[])
+{
+    // cubic with uneven and repeated knots, so span searches take the general path
+    int cpCount = 40;
+    int stride = 3;
+    OwningBSpline spline(stride);
+    spline.resize(cpCount);
+    vector<float> knots(cpCount + spline.order);
+    for(int i = 0; i < (int)knots.size(); i++) {
+        int k = (i < spline.order) ? 0 : ((i >= cpCount) ? cpCount - spline.order + 1 : i - spline.order + 1);
+        knots[i] = float(k) + ((k % 3 == 1) ? 0.4f : 0.0f);
+    }
+    knots[20] = knots[19];
+    if(!spline.init(stride, cpCount, &knots[0])) {
+        cout << "stress: knot vector rejected" << endl;
+        return 1;
+    }
+    for(int i = 0; i < cpCount; i++) {
+        spline.cpBuffer[i * stride] = float(i);
+        spline.cpBuffer[i * stride + 1] = float((i * 7) % 5);
+        spline.cpBuffer[i * stride + 2] = float((i * 3) % 4) * 0.5f;
+    }
+    spline.touch();
+
+    Hodograph hodograph(spline, 2);
+    hodograph.update();
+
+    Parametizer quadrature(spline, &hodograph);
+    quadrature.init(Parametizer::Quadrature);
+    Parametizer table(spline);
+    table.init(Parametizer::Table);
+    Parametizer chebyshev(spline);
+    chebyshev.init(Parametizer::Chebyshev);
+
+    Shared shared = { spline, hodograph, quadrature, table, chebyshev };
+
+    vector<vector<float> > expected(queryCount);
+    for(int i = 0; i < queryCount; i++)
+        query(shared, i, expected[i]);
+
+    vector<vector<vector<float> > > results(threadCount, vector<vector<float> >(queryCount));
+    vector<thread> threads;
+    for(int k = 0; k < threadCount; k++)
+        threads.push_back(thread(worker, cref(shared), k * queryCount / threadCount, ref(results[k])));
+    for(int k = 0; k < threadCount; k++)
+        threads[k].join();
+
+    int mismatches = 0;
+    for(int k = 0; k < threadCount; k++)
+        for(int i = 0; i < queryCount; i++)
+            if(results[k][i] != expected[i]) mismatches++;
+
+    if(mismatches) {
+        cout << "stress: " << mismatches << " queries differ from the single-threaded results" << endl;
+        return 1;
+    }
+    cout << "stress: " << threadCount << " threads x " << passes * queryCount << " queries match" << endl;
+    return 0;
+}